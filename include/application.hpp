@@ -1,5 +1,12 @@
 #include <SDL.h>
 #include <string>
+#include <deque>
+
+#ifndef __EMSCRIPTEN__
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#endif
 
 #define RST_DECLARE_MAIN(APP_CLASS) \
 int main(int argc, char* argv[])    \
@@ -25,19 +32,38 @@ private:
 	static void _main_loop(void* arg);
 #endif
 	void _frame();
+	void _render_loop();
     void _event_loop();
 	bool _initialize();
 	void _shutdown();
 	void _update_delta_time();
 	void _clear_screen(uint8_t r, uint8_t b, uint8_t g, uint8_t a);
 	void _present();
+	void _toggle_trace();
 
 protected:
 	virtual bool initialize() = 0;
-	virtual void frame() = 0;
 	virtual void shutdown() = 0;
 	void update_backbuffer(void* pixels);
 
+	// Zero-copy presentation: returns the pixels of the streaming backbuffer for the current frame, 'pitch' bytes per
+	// row, to resolve a color target straight into. unlock_backbuffer() uploads and draws them. Main thread only.
+	void* lock_backbuffer(uint32_t& pitch);
+	void unlock_backbuffer();
+
+	// Serial frames: frame() renders and presents one frame on the main thread.
+	virtual void frame() {}
+
+	// Pipelined frames, enabled by calling set_pipelined_frames() from initialize(). render() runs on a separate thread
+	// and draws into the render targets of ring slot 'index', while the main thread hands the slots rendered before it to
+	// present(), in order, to upload them with lock_backbuffer(). A slot is only rendered again once its present()
+	// returned. render() must not call into SDL, and must synchronize any state it shares with the main thread.
+	virtual void render(uint32_t /*index*/) {}
+	virtual void present(uint32_t /*index*/) {}
+
+	// Number of ring slots, 2 or 3; 0 returns to serial frames. More slots let rendering run further ahead of presentation.
+	void set_pipelined_frames(uint32_t count);
+
 private:
     bool		  m_is_running;
     SDL_Window*   m_sdl_window;
@@ -45,6 +71,21 @@ private:
 	SDL_Texture*  m_sdl_backbuffer;
 	uint32_t	  m_last_delta_time;
 
+	// Set by F12 and handled once the frame's profiler scopes have closed.
+	bool		  m_toggle_trace;
+
+	// Ring of pipelined frame slots: rendered slots wait in m_ready_slots for presentation, and the render thread waits
+	// while no slot is free.
+	uint32_t			 m_pipelined_frames;
+	uint32_t			 m_free_slots;
+	std::deque<uint32_t> m_ready_slots;
+	bool				 m_render_exit;
+#ifndef __EMSCRIPTEN__
+	std::thread				m_render_thread;
+	std::mutex				m_render_mutex;
+	std::condition_variable m_render_cv;
+#endif
+
 protected:
 	float		  m_delta_time;
 	uint32_t	  m_width;
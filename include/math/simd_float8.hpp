@@ -15,10 +15,19 @@ namespace math
                 _mm256_zeroupper();
             }
             
+            inline static float8 broadcast(const float& _v)
+            {
+                return _mm256_set1_ps(_v);
+            }
+            
+            inline static float8 select(const float8& mask, const float8& a, const float8& b)
+            {
+                return _mm256_blendv_ps(b.data, a.data, mask.data);
+            }
+            
             inline float8(const float& _v0 = 0.0f, const float& _v1 = 0.0f, const float& _v2 = 0.0f, const float& _v3 = 0.0f, const float& _v4 = 0.0f, const float& _v5 = 0.0f, const float& _v6 = 0.0f, const float& _v7 = 0.0f)
             {
-                float v[] = { _v0, _v1, _v2, _v3, _v4, _v5, _v6, _v7 };
-                load(&v[0]);
+                data = _mm256_setr_ps(_v0, _v1, _v2, _v3, _v4, _v5, _v6, _v7);
             }
             
             inline float8(__m256 _data) : data(_data)
@@ -53,11 +62,53 @@ namespace math
                 data = _mm256_load_ps(_data);
             }
             
-            inline void store(float* _data)
+            inline void store(float* _data) const
             {
                 _mm256_store_ps(_data, data);
             }
             
+            inline void load_unaligned(const float* _data)
+            {
+                data = _mm256_loadu_ps(_data);
+            }
+            
+            inline void store_unaligned(float* _data) const
+            {
+                _mm256_storeu_ps(_data, data);
+            }
+            
+            inline void load_masked(const float* _data, const float8& mask)
+            {
+                data = _mm256_maskload_ps(_data, _mm256_castps_si256(mask.data));
+            }
+            
+            inline void store_masked(float* _data, const float8& mask) const
+            {
+                _mm256_maskstore_ps(_data, _mm256_castps_si256(mask.data), data);
+            }
+            
+            inline float reduce_min() const
+            {
+                __m256 v = _mm256_min_ps(data, _mm256_permute2f128_ps(data, data, 1));
+                v = _mm256_min_ps(v, _mm256_shuffle_ps(v, v, _MM_SHUFFLE(1, 0, 3, 2)));
+                v = _mm256_min_ps(v, _mm256_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1)));
+                return _mm256_cvtss_f32(v);
+            }
+            
+            inline float reduce_max() const
+            {
+                __m256 v = _mm256_max_ps(data, _mm256_permute2f128_ps(data, data, 1));
+                v = _mm256_max_ps(v, _mm256_shuffle_ps(v, v, _MM_SHUFFLE(1, 0, 3, 2)));
+                v = _mm256_max_ps(v, _mm256_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1)));
+                return _mm256_cvtss_f32(v);
+            }
+            
+            // One bit per lane, taken from the sign bit.
+            inline int movemask() const
+            {
+                return _mm256_movemask_ps(data);
+            }
+            
             friend float8 operator+(const float8& lhs, const float8& rhs)
             {
                 return _mm256_add_ps(lhs.data, rhs.data);
@@ -77,6 +128,51 @@ namespace math
             {
                 return _mm256_div_ps(lhs.data, rhs.data);
             }
+            
+            friend float8 operator&(const float8& lhs, const float8& rhs)
+            {
+                return _mm256_and_ps(lhs.data, rhs.data);
+            }
+            
+            friend float8 operator|(const float8& lhs, const float8& rhs)
+            {
+                return _mm256_or_ps(lhs.data, rhs.data);
+            }
+            
+            friend float8 operator<(const float8& lhs, const float8& rhs)
+            {
+                return _mm256_cmp_ps(lhs.data, rhs.data, _CMP_LT_OQ);
+            }
+            
+            friend float8 operator<=(const float8& lhs, const float8& rhs)
+            {
+                return _mm256_cmp_ps(lhs.data, rhs.data, _CMP_LE_OQ);
+            }
+            
+            friend float8 operator>(const float8& lhs, const float8& rhs)
+            {
+                return _mm256_cmp_ps(lhs.data, rhs.data, _CMP_GT_OQ);
+            }
+            
+            friend float8 operator>=(const float8& lhs, const float8& rhs)
+            {
+                return _mm256_cmp_ps(lhs.data, rhs.data, _CMP_GE_OQ);
+            }
+            
+            friend float8 min(const float8& lhs, const float8& rhs)
+            {
+                return _mm256_min_ps(lhs.data, rhs.data);
+            }
+            
+            friend float8 max(const float8& lhs, const float8& rhs)
+            {
+                return _mm256_max_ps(lhs.data, rhs.data);
+            }
+            
+            friend float8 sqrt(const float8& v)
+            {
+                return _mm256_sqrt_ps(v.data);
+            }
         };
     }
 }
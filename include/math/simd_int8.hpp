@@ -0,0 +1,163 @@
+#pragma once
+
+#include <math/simd_float8.hpp>
+#include <stdint.h>
+
+namespace math
+{
+    namespace simd
+    {
+        // Eight 32-bit integer lanes. Requires AVX2.
+        struct int8
+        {
+            __m256i data;
+            
+            inline static int8 broadcast(const int32_t& _v)
+            {
+                return _mm256_set1_epi32(_v);
+            }
+            
+            // Truncates towards zero.
+            inline static int8 convert(const float8& v)
+            {
+                return _mm256_cvttps_epi32(v.data);
+            }
+            
+            // Reinterprets the bits, used to turn float comparison results into integer masks.
+            inline static int8 as_int(const float8& v)
+            {
+                return _mm256_castps_si256(v.data);
+            }
+            
+            inline int8(const int32_t& _v0 = 0, const int32_t& _v1 = 0, const int32_t& _v2 = 0, const int32_t& _v3 = 0, const int32_t& _v4 = 0, const int32_t& _v5 = 0, const int32_t& _v6 = 0, const int32_t& _v7 = 0)
+            {
+                data = _mm256_setr_epi32(_v0, _v1, _v2, _v3, _v4, _v5, _v6, _v7);
+            }
+            
+            inline int8(__m256i _data) : data(_data)
+            {
+                
+            }
+            
+            inline int8(const int8& rhs) : data(rhs.data)
+            {
+                
+            }
+            
+            inline int8& operator=(const __m256i& rhs)
+            {
+                data = rhs;
+                return *this;
+            }
+            
+            inline int8& operator=(const int8& rhs)
+            {
+                data = rhs.data;
+                return *this;
+            }
+            
+            inline void load(const int32_t* _data)
+            {
+                data = _mm256_load_si256((const __m256i*)_data);
+            }
+            
+            inline void store(int32_t* _data) const
+            {
+                _mm256_store_si256((__m256i*)_data, data);
+            }
+            
+            inline void store_unaligned(int32_t* _data) const
+            {
+                _mm256_storeu_si256((__m256i*)_data, data);
+            }
+            
+            inline void store_masked(int32_t* _data, const int8& mask) const
+            {
+                _mm256_maskstore_epi32((int*)_data, mask.data, data);
+            }
+            
+            inline float8 to_float() const
+            {
+                return _mm256_cvtepi32_ps(data);
+            }
+            
+            // Reinterprets the bits, used to turn integer comparison results into float masks.
+            inline float8 as_float() const
+            {
+                return _mm256_castsi256_ps(data);
+            }
+            
+            friend int8 operator+(const int8& lhs, const int8& rhs)
+            {
+                return _mm256_add_epi32(lhs.data, rhs.data);
+            }
+            
+            friend int8 operator-(const int8& lhs, const int8& rhs)
+            {
+                return _mm256_sub_epi32(lhs.data, rhs.data);
+            }
+            
+            friend int8 operator*(const int8& lhs, const int8& rhs)
+            {
+                return _mm256_mullo_epi32(lhs.data, rhs.data);
+            }
+            
+            friend int8 operator&(const int8& lhs, const int8& rhs)
+            {
+                return _mm256_and_si256(lhs.data, rhs.data);
+            }
+            
+            friend int8 operator|(const int8& lhs, const int8& rhs)
+            {
+                return _mm256_or_si256(lhs.data, rhs.data);
+            }
+            
+            friend int8 operator<<(const int8& lhs, const int& rhs)
+            {
+                return _mm256_slli_epi32(lhs.data, rhs);
+            }
+            
+            friend int8 operator>>(const int8& lhs, const int& rhs)
+            {
+                return _mm256_srli_epi32(lhs.data, rhs);
+            }
+            
+            friend int8 operator>>(const int8& lhs, const int8& rhs)
+            {
+                return _mm256_srlv_epi32(lhs.data, rhs.data);
+            }
+            
+            friend int8 operator>(const int8& lhs, const int8& rhs)
+            {
+                return _mm256_cmpgt_epi32(lhs.data, rhs.data);
+            }
+            
+            friend int8 operator<(const int8& lhs, const int8& rhs)
+            {
+                return _mm256_cmpgt_epi32(rhs.data, lhs.data);
+            }
+            
+            friend int8 min(const int8& lhs, const int8& rhs)
+            {
+                return _mm256_min_epi32(lhs.data, rhs.data);
+            }
+            
+            friend int8 max(const int8& lhs, const int8& rhs)
+            {
+                return _mm256_max_epi32(lhs.data, rhs.data);
+            }
+        };
+        
+        // Loads base[index] for every lane.
+        inline float8 gather(const float* base, const int8& index)
+        {
+            return _mm256_i32gather_ps(base, index.data, 4);
+        }
+        
+        // Loads base[index] for every lane.
+        inline int8 gather(const int32_t* base, const int8& index)
+        {
+            return _mm256_i32gather_epi32((const int*)base, index.data, 4);
+        }
+    }
+}
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <math/simd_vec4x8.hpp>
+#include <math/mat4.hpp>
 
 namespace math
 {
@@ -18,6 +19,17 @@ namespace math
                 col[3] = _col3;
             }
             
+            // Replicates a single matrix into all eight lanes.
+            inline static mat4fx8 broadcast(const mat4<float>& m)
+            {
+                mat4fx8 r;
+                
+                for (int i = 0; i < 4; i++)
+                    r.col[i] = vec4fx8(float8::broadcast(m.column[i].x), float8::broadcast(m.column[i].y), float8::broadcast(m.column[i].z), float8::broadcast(m.column[i].w));
+                
+                return r;
+            }
+            
             inline mat4fx8(const mat4fx8& rhs)
             {
                 col[0] = rhs.col[0];
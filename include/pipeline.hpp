@@ -0,0 +1,513 @@
+#pragma once
+
+#include <rasterator.hpp>
+#include <math/simd_int8.hpp>
+
+#include <algorithm>
+#include <math.h>
+
+// Rasterizer internals shared between rasterator.cpp and the templated shader path in shader.hpp.
+
+namespace rst
+{
+	// Screen-space tile size used by the binning rasterizer.
+	static const int32_t kTileSize = 64;
+
+	// Block size used for trivial accept and reject within a tile. Matches the SIMD span width.
+	static const int32_t kBlockSize = 8;
+
+	// Swizzled textures are stored in blocks of 4x4 texels, which fill one 64 byte cache line.
+	static const int32_t kTexelBlockBits = 2;
+	static const int32_t kTexelBlockSize = 1 << kTexelBlockBits;
+
+	// Edge function values are clamped to this before being stepped across a tile.
+	static const int32_t kMaxEdgeValue = 1 << 30;
+
+	// Maximum number of floats a vertex can pass on to the fragment stage.
+	static const uint32_t kMaxVaryings = 16;
+
+	// Integer edge equation evaluated at pixel centers: E(x, y) = a * x + b * y + c. A pixel is inside the edge if E >= 0.
+	struct EdgeEquation
+	{
+		int32_t a;
+		int32_t b;
+		int64_t c;
+	};
+
+	// Vertex after transformation to clip space, with the attributes to interpolate across the triangle.
+	struct ClipVertex
+	{
+		vec4f position;
+		float varyings[kMaxVaryings];
+	};
+
+	// Triangle after vertex processing, ready to be rasterized.
+	struct TriangleSetup
+	{
+		EdgeEquation edges[3];
+		float		 bary_dx[2];
+		float		 bary_dy[2];
+		float		 bary_c[2];
+		float		 inv_view_z[3];
+		float		 min_z;
+		float		 max_z;
+		int32_t		 min_x;
+		int32_t		 min_y;
+		int32_t		 max_x;
+		int32_t		 max_y;
+
+		// Vertex varyings divided by view space Z, for perspective correct interpolation.
+		float		 varyings[3][kMaxVaryings];
+	};
+
+	// Inclusive pixel bounds of a screen tile.
+	struct Tile
+	{
+		uint32_t index;
+		int32_t	 min_x;
+		int32_t	 min_y;
+		int32_t	 max_x;
+		int32_t	 max_y;
+
+		// Indices of the point lights that can reach the tile, in binding order.
+		const std::vector<uint32_t>* point_lights;
+
+		// Counters of the draw being rasterized and its pixels written so far, one row of bits per tile row. Null unless
+		// statistics are enabled.
+		PipelineStatistics* statistics;
+		uint64_t*			coverage;
+	};
+
+	// Rasterizes a triangle within a tile. 'shader' holds the uniforms of the draw: the user shader object, or the built-in
+	// shading state.
+	typedef void (*RasterizeFunction)(const TriangleSetup& tri, const Tile& tile, Texture* color_tex, Texture* depth_tex, const void* shader);
+
+	// Runs the vertex stage for 'count' vertices. Called from several threads at once on separate ranges.
+	typedef void (*VertexFunction)(const void* shader, const Vertex* vertices, uint32_t count, ClipVertex* out);
+
+	// Type-erased user shader, see Context::set_shader() in shader.hpp.
+	struct ShaderProgram
+	{
+		const void*		  shader;
+		uint32_t		  varying_count;
+		VertexFunction	  vertex;
+
+		// Indexed by whether depth writes are enabled
+		RasterizeFunction rasterize[2];
+	};
+
+	// -----------------------------------------------------------------------------------------------------------------------------------
+
+	inline int32_t evaluate_edge(const EdgeEquation& edge, int32_t x, int32_t y)
+	{
+		// Clamp to a range that keeps stepping within a tile from overflowing. Clamped values are far enough from zero
+		// that their sign stays correct everywhere in the tile.
+		int64_t v = int64_t(edge.a) * x + int64_t(edge.b) * y + edge.c;
+		return int32_t(std::max(std::min(v, int64_t(kMaxEdgeValue)), -int64_t(kMaxEdgeValue)));
+	}
+
+	// -----------------------------------------------------------------------------------------------------------------------------------
+
+	// Counts the pixels of a span that reached the depth test, and those of them that passed.
+	inline void count_span(const Tile& tile, int32_t x, int32_t y, int tested, int passed)
+	{
+		tile.statistics->pixels_tested += _mm_popcnt_u32(tested);
+		tile.statistics->pixels_depth_passed += _mm_popcnt_u32(passed);
+		tile.coverage[y - tile.min_y] |= uint64_t(passed) << (x - tile.min_x);
+	}
+
+	// -----------------------------------------------------------------------------------------------------------------------------------
+
+	// Computes the perspective correct barycentric weights of a span of 8 horizontally adjacent pixels starting at (x, y), and
+	// performs the depth test and write. Returns false if none of the pixels in 'mask' passed.
+	template<bool DepthWrite>
+	inline bool depth_test_span(const TriangleSetup& tri, int32_t x, int32_t y, simd::float8& mask, bool depth_test, Texture* depth_tex, simd::float8& w0, simd::float8& w1, simd::float8& w2)
+	{
+		using namespace simd;
+
+		const float8 one = float8::broadcast(1.0f);
+
+		float8 px = float8::broadcast(float(x)) + float8(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f);
+		float8 py = float8::broadcast(float(y));
+
+		// Calculate barycentric coordinates
+		w1 = float8::broadcast(tri.bary_c[0]) + float8::broadcast(tri.bary_dx[0]) * px + float8::broadcast(tri.bary_dy[0]) * py;
+		w2 = float8::broadcast(tri.bary_c[1]) + float8::broadcast(tri.bary_dx[1]) * px + float8::broadcast(tri.bary_dy[1]) * py;
+		w0 = one - w1 - w2;
+
+		// Calculate interpolated pixel depth
+		float8 z = one / (float8::broadcast(tri.inv_view_z[0]) * w0 + float8::broadcast(tri.inv_view_z[1]) * w1 + float8::broadcast(tri.inv_view_z[2]) * w2);
+
+		// Perform depth test
+		float* depth = &depth_tex->m_depth[depth_tex->texel_offset(x, y)];
+
+		if (depth_test)
+		{
+			float8 depth_value;
+			depth_value.load_masked(depth, mask);
+
+			mask = mask & (z < depth_value);
+
+			if (mask.movemask() == 0)
+				return false;
+		}
+
+		// Update depth buffer values that passed the depth test
+		if (DepthWrite)
+			z.store_masked(depth, mask);
+
+		// Perspective correct weights
+		w0 = w0 * z;
+		w1 = w1 * z;
+		w2 = w2 * z;
+
+		return true;
+	}
+
+	// -----------------------------------------------------------------------------------------------------------------------------------
+
+	// Blends 8 pairs of packed BGRA texels as (a * (256 - t) + b * t) / 256, with 8 bit fractions t. Channels 16 bits apart
+	// share a 32 bit lane and a multiply, so blue and red blend in place, and green and alpha after a shift.
+	inline simd::int8 lerp_texels(const simd::int8& a, const simd::int8& b, const simd::int8& t)
+	{
+		using namespace simd;
+
+		const int8 low_mask = int8::broadcast(0x00FF00FF);
+		const int8 high_mask = int8::broadcast(int32_t(0xFF00FF00));
+		const int8 round = int8::broadcast(0x00800080);
+
+		int8 s = int8::broadcast(256) - t;
+
+		int8 blue_red = ((a & low_mask) * s + (b & low_mask) * t + round) >> 8;
+		int8 green_alpha = ((a >> 8) & low_mask) * s + ((b >> 8) & low_mask) * t + round;
+
+		return (blue_red & low_mask) | (green_alpha & high_mask);
+	}
+
+	// -----------------------------------------------------------------------------------------------------------------------------------
+
+	// Indices of the texels at (x, y) of the mip levels starting at 'offset' and 'width' texels wide, rows counted from the
+	// top as in Texture::sample_offset.
+	inline simd::int8 sample_offsets(const Texture* texture, const simd::int8& x, const simd::int8& y, const simd::int8& width, const simd::int8& offset)
+	{
+		using namespace simd;
+
+		if (texture->m_layout == TEXTURE_LAYOUT_SWIZZLED)
+		{
+			const int8 texel_mask = int8::broadcast(kTexelBlockSize - 1);
+
+			int8 blocks_x = (width + texel_mask) >> kTexelBlockBits;
+			int8 block = (y >> kTexelBlockBits) * blocks_x + (x >> kTexelBlockBits);
+
+			return offset + (block << (kTexelBlockBits * 2)) + ((y & texel_mask) << kTexelBlockBits) + (x & texel_mask);
+		}
+
+		return offset + y * width + x;
+	}
+
+	// -----------------------------------------------------------------------------------------------------------------------------------
+
+	// Nearest samples of level 0 of a texture at 8 coordinates, as packed BGRA texels. Coordinates are clamped to the
+	// texture, so masked off lanes read valid texels too.
+	inline simd::int8 sample_nearest_span(const Texture* texture, const simd::float8& u, const simd::float8& v)
+	{
+		using namespace simd;
+
+		const int8 zero = int8::broadcast(0);
+
+		int8 width = int8::broadcast(texture->m_width);
+		int8 last_x = int8::broadcast(texture->m_width - 1);
+		int8 last_y = int8::broadcast(texture->m_height - 1);
+
+		int8 x = min(max(int8::convert(u * last_x.to_float()), zero), last_x);
+		int8 y = min(max(int8::convert(v * last_y.to_float()), zero), last_y);
+
+		return gather((const int32_t*)texture->m_pixels, sample_offsets(texture, x, y, width, zero));
+	}
+
+	// -----------------------------------------------------------------------------------------------------------------------------------
+
+	// Bilinear samples of a texture at 8 coordinates, each from the mip level in its lane, as packed BGRA texels. Texel
+	// coordinates are 8.8 fixed point, clamped to the level so masked off lanes read valid texels too.
+	inline simd::int8 sample_bilinear_span(const Texture* texture, const simd::float8& u, const simd::float8& v, const simd::int8& level)
+	{
+		using namespace simd;
+
+		const int8 zero = int8::broadcast(0);
+		const int8 one = int8::broadcast(1);
+		const int8 fraction_mask = int8::broadcast(0xFF);
+		const float8 fixed_scale = float8::broadcast(256.0f);
+
+		int8 width = max(int8::broadcast(texture->m_width) >> level, one);
+		int8 height = max(int8::broadcast(texture->m_height) >> level, one);
+		int8 offset = gather((const int32_t*)texture->m_mip_offsets, level);
+
+		int8 last_x = width - one;
+		int8 last_y = height - one;
+
+		// Same mapping as Texture::sample_bilinear: 0 and 1 land on the edge texels
+		int8 x = min(max(int8::convert(u * last_x.to_float() * fixed_scale), zero), last_x << 8);
+		int8 y = min(max(int8::convert(v * last_y.to_float() * fixed_scale), zero), last_y << 8);
+
+		int8 x0 = x >> 8;
+		int8 y0 = y >> 8;
+		int8 x1 = min(x0 + one, last_x);
+		int8 y1 = min(y0 + one, last_y);
+
+		const int32_t* pixels = (const int32_t*)texture->m_pixels;
+
+		int8 c00 = gather(pixels, sample_offsets(texture, x0, y0, width, offset));
+		int8 c10 = gather(pixels, sample_offsets(texture, x1, y0, width, offset));
+		int8 c01 = gather(pixels, sample_offsets(texture, x0, y1, width, offset));
+		int8 c11 = gather(pixels, sample_offsets(texture, x1, y1, width, offset));
+
+		int8 top = lerp_texels(c00, c10, x & fraction_mask);
+		int8 bottom = lerp_texels(c01, c11, x & fraction_mask);
+
+		return lerp_texels(top, bottom, y & fraction_mask);
+	}
+
+	// -----------------------------------------------------------------------------------------------------------------------------------
+
+	// Texture::lod for 8 pixels. log2 is the float exponent plus a cubic fit of the mantissa, exact at powers of two and
+	// within 0.0005 of a level elsewhere.
+	inline simd::float8 lod_span(const Texture* texture, const simd::float8& du_dx, const simd::float8& dv_dx, const simd::float8& du_dy, const simd::float8& dv_dy)
+	{
+		using namespace simd;
+
+		const float8 zero = float8::broadcast(0.0f);
+		const float8 one = float8::broadcast(1.0f);
+
+		float8 width = float8::broadcast(float(texture->m_width));
+		float8 height = float8::broadcast(float(texture->m_height));
+
+		// Squared length of the larger of the pixel's two footprint axes, in level 0 texels
+		float8 x_u = du_dx * width;
+		float8 x_v = dv_dx * height;
+		float8 y_u = du_dy * width;
+		float8 y_v = dv_dy * height;
+
+		float8 length_x = x_u * x_u + x_v * x_v;
+		float8 length_y = y_u * y_u + y_v * y_v;
+
+		// NaN lengths of a zero footprint end up at level 0
+		float8 length = max(length_x, length_y) & (length_x >= zero) & (length_y >= zero);
+		int8 bits = int8::as_int(length);
+
+		float8 exponent = ((bits >> 23) - int8::broadcast(127)).to_float();
+		float8 t = ((bits & int8::broadcast(0x007FFFFF)) | int8::broadcast(0x3F800000)).as_float() - one;
+		float8 mantissa = t * (float8::broadcast(1.4228652f) + t * (float8::broadcast(-0.5820851f) + t * float8::broadcast(0.1592199f)));
+
+		float8 lod = float8::broadcast(0.5f) * (exponent + mantissa);
+
+		return min(max(lod, zero), float8::broadcast(float(texture->m_mip_count - 1)));
+	}
+
+	// -----------------------------------------------------------------------------------------------------------------------------------
+
+	// Recomputes the depth bounds of an 8x8 block from the depth buffer.
+	inline void update_block_depth(Texture* depth_tex, int32_t block_x, int32_t block_y, uint32_t block)
+	{
+		using namespace simd;
+
+		int32_t last_y = std::min(block_y + kBlockSize, int32_t(depth_tex->m_height));
+
+		int8 column = int8::broadcast(block_x) + int8(0, 1, 2, 3, 4, 5, 6, 7);
+		float8 column_mask = (column < int8::broadcast(depth_tex->m_width)).as_float();
+
+		float8 min_depth = float8::broadcast(INFINITY);
+		float8 max_depth = float8::broadcast(-INFINITY);
+
+		for (int32_t y = block_y; y < last_y; y++)
+		{
+			float8 depth;
+			depth.load_masked(&depth_tex->m_depth[depth_tex->texel_offset(block_x, y)], column_mask);
+
+			min_depth = min(min_depth, float8::select(column_mask, depth, float8::broadcast(INFINITY)));
+			max_depth = max(max_depth, float8::select(column_mask, depth, float8::broadcast(-INFINITY)));
+		}
+
+		depth_tex->m_block_min_depth[block] = min_depth.reduce_min();
+		depth_tex->m_block_max_depth[block] = max_depth.reduce_max();
+	}
+
+	// -----------------------------------------------------------------------------------------------------------------------------------
+
+	// Recomputes the farthest depth of a tile from the depth bounds of its blocks.
+	inline void update_tile_depth(Texture* depth_tex, const Tile& tile, uint32_t tile_index)
+	{
+		uint32_t blocks_x = (depth_tex->m_width + kBlockSize - 1) / kBlockSize;
+		float max_depth = -INFINITY;
+
+		for (int32_t y = tile.min_y / kBlockSize; y <= tile.max_y / kBlockSize; y++)
+		{
+			for (int32_t x = tile.min_x / kBlockSize; x <= tile.max_x / kBlockSize; x++)
+				max_depth = std::max(max_depth, depth_tex->m_block_max_depth[y * blocks_x + x]);
+		}
+
+		depth_tex->m_tile_max_depth[tile_index] = max_depth;
+	}
+
+	// -----------------------------------------------------------------------------------------------------------------------------------
+
+	// Walks the 8x8 blocks of a triangle within a tile and calls shade(x, y, mask, depth_test) for every span of 8 pixels
+	// that may be covered, where mask holds the pixels inside the triangle and depth_test is false if the triangle is in
+	// front of everything already drawn there. shade returns the mask of the pixels it wrote.
+	template<bool DepthWrite, typename SpanFunction>
+	inline void traverse_triangle(const TriangleSetup& tri, const Tile& tile, Texture* depth_tex, const SpanFunction& shade)
+	{
+		using namespace simd;
+
+		// Hierarchical Z: skip the triangle if it is behind everything already drawn in the tile
+		if (tri.min_z >= depth_tex->m_tile_max_depth[tile.index])
+		{
+			if (tile.statistics)
+				tile.statistics->tiles_hiz_culled++;
+
+			return;
+		}
+
+		// Restrict the bounding box to the tile owned by the calling thread
+		int32_t min_x = std::max(tri.min_x, tile.min_x);
+		int32_t min_y = std::max(tri.min_y, tile.min_y);
+		int32_t max_x = std::min(tri.max_x, tile.max_x);
+		int32_t max_y = std::min(tri.max_y, tile.max_y);
+
+		// Blocks are aligned to the block grid; tiles are too, so blocks never cross into another tile
+		int32_t start_x = min_x & ~(kBlockSize - 1);
+		int32_t start_y = min_y & ~(kBlockSize - 1);
+
+		int8 lanes = int8(0, 1, 2, 3, 4, 5, 6, 7);
+		int8 first_column = int8::broadcast(min_x - 1);
+		int8 last_column = int8::broadcast(max_x + 1);
+		int8 negative_one = int8::broadcast(-1);
+
+		int32_t block_row[3];
+		int32_t reject_offset[3];
+		int32_t accept_offset[3];
+
+		for (int i = 0; i < 3; i++)
+		{
+			const EdgeEquation& edge = tri.edges[i];
+
+			// Edge function value at the first pixel of the first block
+			block_row[i] = evaluate_edge(edge, start_x, start_y);
+
+			// Offsets from a block's first pixel to the block pixel with the largest and the smallest edge function value
+			reject_offset[i] = std::max(edge.a, 0) * (kBlockSize - 1) + std::max(edge.b, 0) * (kBlockSize - 1);
+			accept_offset[i] = std::min(edge.a, 0) * (kBlockSize - 1) + std::min(edge.b, 0) * (kBlockSize - 1);
+		}
+
+		uint32_t blocks_x = (depth_tex->m_width + kBlockSize - 1) / kBlockSize;
+		bool depth_written = false;
+
+		// Iterate over blocks in triangle bounding box
+		for (int32_t block_y = start_y; block_y <= max_y; block_y += kBlockSize)
+		{
+			int32_t block[3] = { block_row[0], block_row[1], block_row[2] };
+
+			int32_t first_y = std::max(block_y, min_y);
+			int32_t last_y = std::min(block_y + kBlockSize - 1, max_y);
+
+			for (int32_t block_x = start_x; block_x <= max_x; block_x += kBlockSize)
+			{
+				// Trivial reject if the block is entirely outside any edge, trivial accept if it is entirely inside all of them
+				bool outside = false;
+				bool inside = true;
+
+				for (int i = 0; i < 3; i++)
+				{
+					outside = outside || (block[i] + reject_offset[i] < 0);
+					inside = inside && (block[i] + accept_offset[i] >= 0);
+				}
+
+				uint32_t block_index = (block_y / kBlockSize) * blocks_x + block_x / kBlockSize;
+
+				// Hierarchical Z: skip the block if the triangle is behind everything already drawn in it, and skip the
+				// per-pixel depth test if it is in front of everything
+				if (!outside && tri.min_z >= depth_tex->m_block_max_depth[block_index])
+				{
+					outside = true;
+
+					if (tile.statistics)
+						tile.statistics->blocks_hiz_culled++;
+				}
+
+				bool depth_test = tri.max_z >= depth_tex->m_block_min_depth[block_index];
+
+				if (!outside)
+				{
+					int written = 0;
+
+					// Pixels of the block within the bounding box
+					int8 column = int8::broadcast(block_x) + lanes;
+					int8 column_mask = (column > first_column) & (column < last_column);
+
+					if (inside)
+					{
+						// Fully covered, no edge tests needed
+						for (int32_t y = first_y; y <= last_y; y++)
+						{
+							int passed = shade(block_x, y, column_mask.as_float(), depth_test);
+
+							if (tile.statistics)
+								count_span(tile, block_x, y, column_mask.as_float().movemask(), passed);
+
+							written |= passed;
+						}
+					}
+					else
+					{
+						// Partially covered, fall back to per-pixel edge tests
+						int8 e0 = int8::broadcast(block[0] + tri.edges[0].b * (first_y - block_y)) + int8::broadcast(tri.edges[0].a) * lanes;
+						int8 e1 = int8::broadcast(block[1] + tri.edges[1].b * (first_y - block_y)) + int8::broadcast(tri.edges[1].a) * lanes;
+						int8 e2 = int8::broadcast(block[2] + tri.edges[2].b * (first_y - block_y)) + int8::broadcast(tri.edges[2].a) * lanes;
+
+						int8 step_y0 = int8::broadcast(tri.edges[0].b);
+						int8 step_y1 = int8::broadcast(tri.edges[1].b);
+						int8 step_y2 = int8::broadcast(tri.edges[2].b);
+
+						for (int32_t y = first_y; y <= last_y; y++)
+						{
+							// Which pixels of the span are within the triangle and the bounding box?
+							float8 mask = (((e0 | e1 | e2) > negative_one) & column_mask).as_float();
+
+							int tested = mask.movemask();
+
+							if (tested != 0)
+							{
+								int passed = shade(block_x, y, mask, depth_test);
+
+								if (tile.statistics)
+									count_span(tile, block_x, y, tested, passed);
+
+								written |= passed;
+							}
+
+							e0 = e0 + step_y0;
+							e1 = e1 + step_y1;
+							e2 = e2 + step_y2;
+						}
+					}
+
+					if (DepthWrite && written)
+					{
+						update_block_depth(depth_tex, block_x, block_y, block_index);
+						depth_written = true;
+					}
+				}
+
+				for (int i = 0; i < 3; i++)
+					block[i] += tri.edges[i].a * kBlockSize;
+			}
+
+			for (int i = 0; i < 3; i++)
+				block_row[i] += tri.edges[i].b * kBlockSize;
+		}
+
+		if (depth_written)
+			update_tile_depth(depth_tex, tile, tile.index);
+	}
+
+	// -----------------------------------------------------------------------------------------------------------------------------------
+} // namespace rst
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+
+// Timeline profiler.
+//
+// Scoped markers record the time spent in a region of code as an event on the timeline of the calling thread:
+//
+//	void frame()
+//	{
+//		RST_PROFILE_SCOPE("Frame");
+//		...
+//	}
+//
+// Every thread records into a ring buffer of its own, so recording takes no locks and only the most recent events of a
+// thread are kept. save_trace() writes the recorded events in the Chrome trace event format, to be opened in
+// chrome://tracing or ui.perfetto.dev. Recording is off by default; a disabled marker costs a single branch.
+
+#define RST_PROFILE_CONCAT_IMPL(A, B) A##B
+#define RST_PROFILE_CONCAT(A, B) RST_PROFILE_CONCAT_IMPL(A, B)
+#define RST_PROFILE_SCOPE(NAME) rst::ProfileScope RST_PROFILE_CONCAT(profile_scope_, __LINE__)(NAME)
+
+namespace rst
+{
+	// Records an event from construction to destruction. 'name' must stay valid until the trace is saved, e.g. a string
+	// literal.
+	class ProfileScope
+	{
+	public:
+		ProfileScope(const char* name);
+		~ProfileScope();
+
+	private:
+		const char* m_name;
+		uint64_t	m_start;
+	};
+
+	extern void set_profiling_enabled(bool enable);
+	extern bool profiling_enabled();
+
+	// Names the calling thread's timeline in the trace. 'name' must stay valid until the trace is saved.
+	extern void set_profiler_thread_name(const char* name);
+
+	// Writes the events recorded since the last save to a Chrome trace JSON file. It reads the other threads' rings without
+	// locks, so they must not record while it runs: stop recording first and wait for them to go idle, e.g. between frames.
+	// It never writes to their rings, so they may record again as soon as it returns.
+	extern bool save_trace(const std::string& file);
+}
@@ -1,3 +1,5 @@
+#pragma once
+
 #include <math/vec3.hpp>
 #include <math/vec2.hpp>
 #include <math/mat4.hpp>
@@ -24,23 +26,80 @@ namespace rst
 {
 	class Color;
 
+	// Enough levels for a 32768x32768 texture.
+	static const uint32_t kMaxMipLevels = 16;
+
+	// Memory layout of a texture's texels.
+	enum TextureLayout
+	{
+		// Row-major. Color rows are stored top to bottom, so the pixels can be presented as is.
+		TEXTURE_LAYOUT_LINEAR   = 0,
+		// 8x8 blocks of contiguous texels, grouped into contiguous 64x64 tiles. Render targets only; use resolve() to
+		// copy the pixels out in linear order.
+		TEXTURE_LAYOUT_TILED    = 1,
+		// 4x4 blocks of contiguous texels, one cache line each, in row order within every mip level. Rows are stored top
+		// to bottom like a linear color texture. For sampled textures, so bilinear footprints mostly stay in one line;
+		// made by swizzle() only, and can't be bound as a render target.
+		TEXTURE_LAYOUT_SWIZZLED = 2
+	};
+
 	class Texture
 	{
 	public:
-		Color*	  m_pixels;
-		float*	  m_depth;
-		uint32_t  m_width;
-		uint32_t  m_height;
+		Color*		  m_pixels;
+		float*		  m_depth;
+		uint32_t	  m_width;
+		uint32_t	  m_height;
+		TextureLayout m_layout;
+
+		// Hierarchical Z: depth bounds of every 8x8 block and the farthest depth of every 64x64 tile of a depth target.
+		float*		  m_block_min_depth;
+		float*		  m_block_max_depth;
+		float*		  m_tile_max_depth;
+
+		// Mip chain of a sampled texture, stored after level 0 in m_pixels. Level i is max(width >> i, 1) by
+		// max(height >> i, 1) texels, starting at m_mip_offsets[i]. Swizzled levels are padded to whole blocks.
+		uint32_t	  m_mip_count;
+		uint32_t	  m_mip_offsets[kMaxMipLevels];
 
 	public:
-		Texture(uint32_t width, uint32_t height, bool depth = false);
+		Texture(uint32_t width, uint32_t height, bool depth = false, TextureLayout layout = TEXTURE_LAYOUT_LINEAR);
 		Texture(const std::string& name);
 		~Texture();
 		void set_depth(float depth, uint32_t x, uint32_t y);
 		void set_color(uint32_t color, uint32_t x, uint32_t y);
 		uint32_t sample(float x, float y);
+		uint32_t sample_nearest(float x, float y, uint32_t level = 0);
+		uint32_t sample_bilinear(float x, float y, uint32_t level = 0);
+
+		// Bilinear sample of the mip level nearest to 'lod'.
+		uint32_t sample_mip_nearest(float x, float y, float lod);
+
+		// Blend of the bilinear samples of the two mip levels around 'lod'.
+		uint32_t sample_trilinear(float x, float y, float lod);
+
+		// Level of detail of a pixel from the screen space derivatives of its texture coordinates, clamped to the mip chain.
+		float lod(float du_dx, float dv_dx, float du_dy, float dv_dy) const;
+
+		// Builds the mip chain of a linear color texture from level 0 with a box filter. Textures loaded from files get
+		// theirs on load.
+		void generate_mips();
+
+		// Converts a linear color texture and its mip chain to TEXTURE_LAYOUT_SWIZZLED. Textures loaded from files are
+		// swizzled on load, after their mips are generated.
+		void swizzle();
 		void clear();
 		void clear(float r, float g, float b, float a);
+
+		// Copies the color pixels out in linear, top to bottom order into any framebuffer, such as a locked streaming
+		// texture, with rows 'pitch' bytes apart.
+		void resolve(void* pixels, uint32_t pitch);
+
+		// Writes a color texture to a PNG, BMP, TGA or JPG file, picked by the file extension.
+		bool save(const std::string& file);
+		uint32_t texel_offset(uint32_t x, uint32_t y) const;
+		uint32_t sample_offset(uint32_t x, uint32_t y, uint32_t level) const;
+		uint32_t texel_count() const;
 	};
 
 	class Color
@@ -122,6 +181,29 @@ namespace rst
 		TEXTURE_SPECULAR = 2
 	};
 
+	enum CullMode
+	{
+		CULL_MODE_NONE  = 0,
+		CULL_MODE_FRONT = 1,
+		CULL_MODE_BACK  = 2
+	};
+
+	// Winding order of front-facing triangles, as seen on screen.
+	enum FrontFace
+	{
+		FRONT_FACE_CCW = 0,
+		FRONT_FACE_CW  = 1
+	};
+
+	enum FilterMode
+	{
+		FILTER_MODE_NEAREST		= 0,
+		FILTER_MODE_BILINEAR	= 1,
+		// Mipmapped: bilinear within the level nearest to the pixel's footprint, or trilinear across the two around it
+		FILTER_MODE_MIP_NEAREST = 2,
+		FILTER_MODE_TRILINEAR	= 3
+	};
+
 	struct DirectionalLight
 	{
 		vec3f direction;
@@ -137,18 +219,188 @@ namespace rst
 		float quadratic;
 	};
 
+	// Time spent in each pipeline stage, in nanoseconds, summed over the batches a context executed since the last
+	// reset_stage_timings(). Setup covers clipping, triangle setup, binning and light culling.
+	struct StageTimings
+	{
+		uint64_t vertex = 0;
+		uint64_t setup = 0;
+		uint64_t raster = 0;
+		uint64_t batches = 0;
+	};
+
+	// Work done by the pipeline stages, gathered while enabled with Context::set_statistics_enabled(). Triangles split by
+	// clipping are counted by the culling counters once for every piece.
+	struct PipelineStatistics
+	{
+		uint64_t triangles_submitted = 0;
+		// Entirely outside the view frustum or the render target
+		uint64_t triangles_frustum_culled = 0;
+		// Clipped against the near plane or the guard band
+		uint64_t triangles_clipped = 0;
+		uint64_t triangles_backface_culled = 0;
+		uint64_t triangles_zero_area_culled = 0;
+		// Work rejected by hierarchical Z without testing any pixel: a triangle in one of the tiles it was binned to, and
+		// 8x8 blocks the triangle's edges reach. Their pixels are not counted below.
+		uint64_t tiles_hiz_culled = 0;
+		uint64_t blocks_hiz_culled = 0;
+		// Pixels inside a triangle that reached the depth test
+		uint64_t pixels_tested = 0;
+		uint64_t pixels_depth_passed = 0;
+		uint64_t pixels_depth_failed = 0;
+		// Distinct pixels written within a batch
+		uint64_t pixels_covered = 0;
+		// Built-in shading only; the work of user shaders is not counted
+		uint64_t texture_samples = 0;
+		uint64_t light_evaluations = 0;
+
+		// Average number of times each covered pixel was written.
+		double overdraw_ratio() const
+		{
+			return pixels_covered > 0 ? double(pixels_depth_passed) / double(pixels_covered) : 0.0;
+		}
+	};
+
+	struct ContextState;
+	struct CommandListData;
+	struct ShaderProgram;
+
+	// Records state changes and draws for later submission to a Context. Recording is cheap and touches no context state,
+	// so separate lists can be recorded on separate threads at the same time. Lights and matrices are copied into the
+	// list; buffers, textures and shaders are referenced and must stay alive until the list is submitted.
+	class CommandList
+	{
+	public:
+		CommandList();
+		~CommandList();
+
+		// Removes all recorded commands, keeping the allocations for the next recording.
+		void reset();
+
+		void set_vertex_buffer(VertexBuffer* vb);
+		void set_index_buffer(IndexBuffer* ib);
+		void set_directional_lights(uint32_t count, const DirectionalLight* lights);
+		void set_point_lights(uint32_t count, const PointLight* lights);
+		void set_render_target(Texture* color, Texture* depth);
+		void set_model_matrix(const mat4f& model);
+		void set_view_matrix(const mat4f& view);
+		void set_projection_matrix(const mat4f& projection);
+		void set_cull_mode(CullMode mode);
+		void set_front_face(FrontFace face);
+		void set_filter_mode(FilterMode mode);
+		void set_depth_write(bool enable);
+		void set_texture(const uint32_t& type, Texture* texture);
+		void set_shader_program(const ShaderProgram& program);
+		void reset_shader();
+		void draw(uint32_t first_index, uint32_t count);
+		void draw_indexed(uint32_t count);
+		void draw_indexed_base_vertex(uint32_t index_count, uint32_t base_index, uint32_t base_vertex);
+
+		// Defined in shader.hpp.
+		template<typename Shader>
+		void set_shader(const Shader* shader);
+
+	private:
+		friend class Context;
+
+		CommandList(const CommandList&) = delete;
+		CommandList& operator=(const CommandList&) = delete;
+
+		CommandListData* m_data;
+	};
+
+	// Owns the bound pipeline state and the scratch memory of its draws. Separate contexts may render on separate threads
+	// at the same time, as long as they do not share render targets; a single context must only be used by one thread at a
+	// time.
+	class Context
+	{
+	public:
+		Context();
+		~Context();
+
+		// Restores the default state.
+		void reset();
+
+		// Number of threads a draw is split across. 0 uses the OpenMP default.
+		void set_thread_count(uint32_t count);
+
+		void set_vertex_buffer(VertexBuffer* vb);
+		void set_index_buffer(IndexBuffer* ib);
+		void set_directional_lights(uint32_t count, const DirectionalLight* lights);
+		void set_point_lights(uint32_t count, const PointLight* lights);
+		void set_render_target(Texture* color, Texture* depth);
+		void set_model_matrix(const mat4f& model);
+		void set_view_matrix(const mat4f& view);
+		void set_projection_matrix(const mat4f& projection);
+		void set_cull_mode(CullMode mode);
+		void set_front_face(FrontFace face);
+		void set_filter_mode(FilterMode mode);
+		void set_depth_write(bool enable);
+		void set_texture(const uint32_t& type, Texture* texture);
+		void set_shader_program(const ShaderProgram& program);
+		void reset_shader();
+		void draw(uint32_t first_index, uint32_t count);
+		void draw_indexed(uint32_t count);
+		void draw_indexed_base_vertex(uint32_t index_count, uint32_t base_index, uint32_t base_vertex);
+
+		// Executes recorded command lists in order, as if their calls had been made on the context directly. State set by
+		// one list carries over into the next. Draws are batched until the end of the submission or the next render target
+		// change: the vertex and setup work of all draws in a batch is spread across threads together, and every tile is
+		// rasterized once for the whole batch.
+		void submit(const CommandList& list);
+		void submit(uint32_t count, const CommandList* lists);
+
+		const StageTimings& stage_timings() const;
+		void reset_stage_timings();
+
+		// Pipeline statistics, counted by every thread on its own and merged at the end of each batch. Off by default.
+		void set_statistics_enabled(bool enable);
+
+		// Totals over the draws executed since the last reset_statistics(), e.g. one frame.
+		const PipelineStatistics& statistics() const;
+
+		// One entry for each draw executed since the last reset_statistics(), in submission order.
+		const std::vector<PipelineStatistics>& draw_statistics() const;
+
+		void reset_statistics();
+
+		// Defined in shader.hpp.
+		template<typename Shader>
+		void set_shader(const Shader* shader);
+
+	private:
+		Context(const Context&) = delete;
+		Context& operator=(const Context&) = delete;
+
+		ContextState* m_state;
+	};
+
+	// Context used by the free functions below.
+	extern Context& default_context();
+
+	// Sets the directory that the file names given to Texture and create_model are relative to. Empty by default, i.e. the
+	// working directory. Not thread-safe; set it once at startup.
+	extern void set_base_path(const std::string& path);
+
 	extern bool create_model(const std::string& file, Model& model);
 	extern void initialize();
 	extern void set_vertex_buffer(VertexBuffer* vb);
 	extern void set_index_buffer(IndexBuffer* ib);
-	extern void set_directional_lights(uint32_t count, DirectionalLight* lights);
-	extern void set_point_lights(uint32_t count, PointLight* lights);
+	extern void set_directional_lights(uint32_t count, const DirectionalLight* lights);
+	extern void set_point_lights(uint32_t count, const PointLight* lights);
 	extern void set_render_target(Texture* color, Texture* depth);
 	extern void set_model_matrix(const mat4f& model);
 	extern void set_view_matrix(const mat4f& view);
 	extern void set_projection_matrix(const mat4f& projection);
+	extern void set_cull_mode(CullMode mode);
+	extern void set_front_face(FrontFace face);
+	extern void set_filter_mode(FilterMode mode);
+	extern void set_depth_write(bool enable);
 	extern void set_texture(const uint32_t& type, Texture* texture);
+	extern void reset_shader();
 	extern void draw(uint32_t first_index, uint32_t count);
 	extern void draw_indexed(uint32_t count);
 	extern void draw_indexed_base_vertex(uint32_t index_count, uint32_t base_index, uint32_t base_vertex);
+	extern void submit(const CommandList& list);
+	extern void submit(uint32_t count, const CommandList* lists);
 }
\ No newline at end of file
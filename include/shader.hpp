@@ -0,0 +1,194 @@
+#pragma once
+
+#include <pipeline.hpp>
+#include <string.h>
+#include <type_traits>
+
+// Programmable shading.
+//
+// A shader is a functor type that declares its varyings as a struct and provides a vertex and a fragment stage:
+//
+//	struct MyShader
+//	{
+//		struct Varyings
+//		{
+//			vec3f normal;
+//			vec2f texcoord;
+//		};
+//
+//		// Returns the clip space position of a vertex and writes its varyings.
+//		vec4f vertex(const rst::Vertex& in, Varyings& out) const;
+//
+//		// Returns the color of a pixel, each channel in [0, 1], from the perspective correct interpolated varyings.
+//		vec4f fragment(const Varyings& in) const;
+//	};
+//
+// Varyings may only hold floats, at most kMaxVaryings of them, and only those are interpolated. Uniforms are members of
+// the shader. Both stages are inlined into the rasterizer loops. Bind a shader with context.set_shader(&shader), or
+// rst::set_shader(&shader) for the default context, and draw as usual; reset_shader() returns to the built-in shading. The
+// shader object must outlive the draws that use it.
+
+namespace rst
+{
+	// Converts a pixel as returned by Texture::sample into a color with channels in [0, 1].
+	inline vec4f unpack_color(uint32_t pixel)
+	{
+		// Pixels are stored as BGRA in memory
+		return vec4f(((pixel >> 16) & 0xFF) / 255.0f, ((pixel >> 8) & 0xFF) / 255.0f, (pixel & 0xFF) / 255.0f, (pixel >> 24) / 255.0f);
+	}
+
+	// -----------------------------------------------------------------------------------------------------------------------------------
+
+	template<typename Shader>
+	void run_vertex_shader(const void* shader, const Vertex* vertices, uint32_t count, ClipVertex* out)
+	{
+		typedef typename Shader::Varyings Varyings;
+
+		const Shader& program = *static_cast<const Shader*>(shader);
+
+		for (uint32_t i = 0; i < count; i++)
+		{
+			Varyings varyings;
+
+			out[i].position = program.vertex(vertices[i], varyings);
+			memcpy(out[i].varyings, &varyings, sizeof(Varyings));
+		}
+	}
+
+	// -----------------------------------------------------------------------------------------------------------------------------------
+
+	// Runs the fragment shader for the covered pixels of a span of 8 horizontally adjacent pixels starting at (x, y). Returns
+	// the mask of the pixels written.
+	template<typename Shader, bool DepthWrite>
+	inline int run_fragment_shader(const Shader& program, const TriangleSetup& tri, int32_t x, int32_t y, simd::float8 mask, bool depth_test, Texture* color_tex, Texture* depth_tex)
+	{
+		using namespace simd;
+
+		typedef typename Shader::Varyings Varyings;
+
+		const uint32_t varying_count = sizeof(Varyings) / sizeof(float);
+
+		float8 w0, w1, w2;
+
+		if (!depth_test_span<DepthWrite>(tri, x, y, mask, depth_test, depth_tex, w0, w1, w2))
+			return 0;
+
+		// Interpolate the declared varyings for all 8 pixels at once
+		alignas(32) float values[kMaxVaryings][8];
+
+		for (uint32_t i = 0; i < varying_count; i++)
+		{
+			float8 value = float8::broadcast(tri.varyings[0][i]) * w0 + float8::broadcast(tri.varyings[1][i]) * w1 + float8::broadcast(tri.varyings[2][i]) * w2;
+			value.store(values[i]);
+		}
+
+		alignas(32) float red[8] = { 0 };
+		alignas(32) float green[8] = { 0 };
+		alignas(32) float blue[8] = { 0 };
+		alignas(32) float alpha[8] = { 0 };
+
+		int lanes = mask.movemask();
+
+		for (int lane = 0; lane < 8; lane++)
+		{
+			if (lanes & (1 << lane))
+			{
+				float in[kMaxVaryings];
+
+				for (uint32_t i = 0; i < varying_count; i++)
+					in[i] = values[i][lane];
+
+				Varyings varyings;
+				memcpy(&varyings, in, sizeof(Varyings));
+
+				vec4f color = program.fragment(varyings);
+
+				red[lane] = color.x;
+				green[lane] = color.y;
+				blue[lane] = color.z;
+				alpha[lane] = color.w;
+			}
+		}
+
+		// Clamp, scale and pack the channels
+		const float8 zero = float8::broadcast(0.0f);
+		const float8 one = float8::broadcast(1.0f);
+		const float8 max_channel = float8::broadcast(255.0f);
+
+		int8 r = int8::convert(min(max(float8(red), zero), one) * max_channel);
+		int8 g = int8::convert(min(max(float8(green), zero), one) * max_channel);
+		int8 b = int8::convert(min(max(float8(blue), zero), one) * max_channel);
+		int8 a = int8::convert(min(max(float8(alpha), zero), one) * max_channel);
+
+		int8 result = b | (g << 8) | (r << 16) | (a << 24);
+
+		// Write new pixel colors
+		int32_t* pixels = (int32_t*)&color_tex->m_pixels[color_tex->texel_offset(x, y)];
+		result.store_masked(pixels, int8::as_int(mask));
+
+		return mask.movemask();
+	}
+
+	// -----------------------------------------------------------------------------------------------------------------------------------
+
+	template<typename Shader, bool DepthWrite>
+	void rasterize_with_shader(const TriangleSetup& tri, const Tile& tile, Texture* color_tex, Texture* depth_tex, const void* shader)
+	{
+		const Shader& program = *static_cast<const Shader*>(shader);
+
+		traverse_triangle<DepthWrite>(tri, tile, depth_tex, [&](int32_t x, int32_t y, simd::float8 mask, bool depth_test)
+		{
+			return run_fragment_shader<Shader, DepthWrite>(program, tri, x, y, mask, depth_test, color_tex, depth_tex);
+		});
+	}
+
+	// -----------------------------------------------------------------------------------------------------------------------------------
+
+	// Builds the type-erased program of a shader.
+	template<typename Shader>
+	ShaderProgram make_shader_program(const Shader* shader)
+	{
+		typedef typename Shader::Varyings Varyings;
+
+		static_assert(std::is_trivially_copyable<Varyings>::value, "Varyings must be a plain struct of floats");
+		static_assert(sizeof(Varyings) % sizeof(float) == 0, "Varyings must be a plain struct of floats");
+		static_assert(sizeof(Varyings) <= kMaxVaryings * sizeof(float), "Too many varyings");
+
+		ShaderProgram program;
+
+		program.shader = shader;
+		program.varying_count = sizeof(Varyings) / sizeof(float);
+		program.vertex = run_vertex_shader<Shader>;
+		program.rasterize[0] = rasterize_with_shader<Shader, false>;
+		program.rasterize[1] = rasterize_with_shader<Shader, true>;
+
+		return program;
+	}
+
+	// -----------------------------------------------------------------------------------------------------------------------------------
+
+	// Binds a user shader for the following draws of the context.
+	template<typename Shader>
+	void Context::set_shader(const Shader* shader)
+	{
+		set_shader_program(make_shader_program(shader));
+	}
+
+	// -----------------------------------------------------------------------------------------------------------------------------------
+
+	template<typename Shader>
+	void CommandList::set_shader(const Shader* shader)
+	{
+		set_shader_program(make_shader_program(shader));
+	}
+
+	// -----------------------------------------------------------------------------------------------------------------------------------
+
+	template<typename Shader>
+	void set_shader(const Shader* shader)
+	{
+		default_context().set_shader(shader);
+	}
+
+	// -----------------------------------------------------------------------------------------------------------------------------------
+} // namespace rst
@@ -0,0 +1,542 @@
+#include <rasterator.hpp>
+#include <profiler.hpp>
+#include <math/transform.hpp>
+#include <math/utility.hpp>
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <chrono>
+#include <thread>
+#include <memory>
+#include <algorithm>
+#include <stdio.h>
+#include <stdlib.h>
+
+// Renders deterministic scenes offscreen at a set of resolutions and thread counts, and reports the time spent in each
+// stage of a frame along with the frame, triangle and pixel throughput. Meant for tracking performance across releases
+// and for sizing hardware.
+//
+// Usage: rasterator_bench [--scenes=teapot,highpoly,lights,overdraw] [--resolutions=1280x720,1920x1080]
+//                         [--threads=1,0] [--frames=30] [--warmup=3] [--format=csv|json] [--output=file]
+//                         [--trace=file]
+//
+// A thread count of 0 uses every hardware thread. --trace records a timeline of the runs in the Chrome trace format. The teapot scene loads teapot.obj from the working directory.
+
+struct BenchScene
+{
+	std::string name;
+	rst::Model model;
+	rst::DirectionalLight dir_light;
+	std::vector<rst::PointLight> point_lights;
+	vec3f eye;
+	vec3f target;
+	float rotation_speed = 0.0f;
+	uint32_t triangle_count = 0;
+};
+
+struct BenchResult
+{
+	std::string scene;
+	uint32_t width;
+	uint32_t height;
+	uint32_t threads;
+	uint32_t frames;
+	uint32_t triangles;
+
+	// Nanoseconds per frame
+	double clear_ns;
+	double vertex_ns;
+	double setup_ns;
+	double raster_ns;
+	double resolve_ns;
+	double frame_ns;
+};
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static std::vector<std::string> split(const std::string& list, char separator)
+{
+	std::vector<std::string> items;
+	std::stringstream stream(list);
+	std::string item;
+
+	while (std::getline(stream, item, separator))
+	{
+		if (!item.empty())
+			items.push_back(item);
+	}
+
+	return items;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// Appends a UV sphere with counter-clockwise outward facing triangles.
+static void append_sphere(rst::Model& model, const vec3f& center, float radius, uint32_t slices, uint32_t stacks)
+{
+	std::vector<rst::Vertex>& vertices = model.vertex_buffer.vertices;
+	std::vector<uint32_t>& indices = model.index_buffer.indices;
+
+	uint32_t base = uint32_t(vertices.size());
+
+	for (uint32_t stack = 0; stack <= stacks; stack++)
+	{
+		float phi = float(M_PI) * stack / stacks;
+
+		for (uint32_t slice = 0; slice <= slices; slice++)
+		{
+			float theta = 2.0f * float(M_PI) * slice / slices;
+
+			rst::Vertex v;
+
+			v.normal = vec3f(sinf(phi) * cosf(theta), cosf(phi), -sinf(phi) * sinf(theta));
+			v.position = center + v.normal * radius;
+			v.tangent = vec3f(-sinf(theta), 0.0f, -cosf(theta));
+			v.texcoord = vec2f(float(slice) / slices, float(stack) / stacks);
+
+			vertices.push_back(v);
+		}
+	}
+
+	for (uint32_t stack = 0; stack < stacks; stack++)
+	{
+		for (uint32_t slice = 0; slice < slices; slice++)
+		{
+			uint32_t i0 = base + stack * (slices + 1) + slice;
+			uint32_t i1 = i0 + slices + 1;
+
+			indices.push_back(i0);
+			indices.push_back(i1);
+			indices.push_back(i0 + 1);
+
+			indices.push_back(i0 + 1);
+			indices.push_back(i1);
+			indices.push_back(i1 + 1);
+		}
+	}
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// Appends a quad in the XY plane facing +Z.
+static void append_quad(rst::Model& model, const vec3f& center, float half_width, float half_height)
+{
+	std::vector<rst::Vertex>& vertices = model.vertex_buffer.vertices;
+	std::vector<uint32_t>& indices = model.index_buffer.indices;
+
+	uint32_t base = uint32_t(vertices.size());
+
+	for (uint32_t i = 0; i < 4; i++)
+	{
+		rst::Vertex v;
+
+		v.position = center + vec3f((i & 1) ? half_width : -half_width, (i & 2) ? half_height : -half_height, 0.0f);
+		v.normal = vec3f(0.0f, 0.0f, 1.0f);
+		v.tangent = vec3f(1.0f, 0.0f, 0.0f);
+		v.texcoord = vec2f((i & 1) ? 1.0f : 0.0f, (i & 2) ? 1.0f : 0.0f);
+
+		vertices.push_back(v);
+	}
+
+	indices.push_back(base);
+	indices.push_back(base + 1);
+	indices.push_back(base + 3);
+
+	indices.push_back(base);
+	indices.push_back(base + 3);
+	indices.push_back(base + 2);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// Wraps the generated geometry of a scene into a single untextured submodel.
+static void finish_scene(BenchScene& scene)
+{
+	rst::SubModel submodel;
+
+	submodel.index_count = uint32_t(scene.model.index_buffer.indices.size());
+	scene.model.submodels.push_back(submodel);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static bool create_scene(const std::string& name, BenchScene& scene)
+{
+	scene.name = name;
+	scene.dir_light.color = vec3f(1.0f, 1.0f, 1.0f);
+	scene.dir_light.direction = vec3f(1.0f, -1.0f, -1.0f).normalize();
+
+	if (name == "teapot")
+	{
+		// The sample scene
+		if (!rst::create_model("teapot.obj", scene.model))
+		{
+			std::cout << "ERROR: Failed to load teapot.obj!" << std::endl;
+			return false;
+		}
+
+		scene.eye = vec3f(0.0f, 35.0f, 150.0f);
+		scene.target = vec3f(0.0f, 35.0f, 0.0f);
+		scene.rotation_speed = 2.0f;
+	}
+	else if (name == "highpoly")
+	{
+		// About a million small triangles, most of them a few pixels in size
+		append_sphere(scene.model, vec3f(0.0f), 50.0f, 1024, 512);
+		finish_scene(scene);
+
+		scene.eye = vec3f(0.0f, 0.0f, 120.0f);
+		scene.target = vec3f(0.0f);
+		scene.rotation_speed = 2.0f;
+	}
+	else if (name == "lights")
+	{
+		// A grid of spheres lit by many point lights
+		for (int32_t y = 0; y < 8; y++)
+		{
+			for (int32_t x = 0; x < 8; x++)
+				append_sphere(scene.model, vec3f((x - 3.5f) * 25.0f, (y - 3.5f) * 25.0f, 0.0f), 10.0f, 48, 24);
+		}
+
+		finish_scene(scene);
+
+		// Fixed pseudo-random placement, so every run lights the same pixels
+		uint32_t seed = 1;
+
+		for (uint32_t i = 0; i < 128; i++)
+		{
+			float values[6];
+
+			for (uint32_t j = 0; j < 6; j++)
+			{
+				seed = seed * 1664525u + 1013904223u;
+				values[j] = float(seed >> 8) / float(1 << 24);
+			}
+
+			rst::PointLight light;
+
+			light.position = vec3f((values[0] - 0.5f) * 200.0f, (values[1] - 0.5f) * 200.0f, 5.0f + values[2] * 30.0f);
+			light.color = vec3f(values[3], values[4], values[5]);
+			light.constant = 1.0f;
+			light.linear = 0.09f;
+			light.quadratic = 0.032f;
+
+			scene.point_lights.push_back(light);
+		}
+
+		scene.eye = vec3f(0.0f, 0.0f, 240.0f);
+		scene.target = vec3f(0.0f);
+	}
+	else if (name == "overdraw")
+	{
+		// Screen covering quads drawn back to front, so every layer passes the depth test
+		for (uint32_t i = 0; i < 32; i++)
+			append_quad(scene.model, vec3f(0.0f, 0.0f, -100.0f + i * 2.0f), 200.0f, 200.0f);
+
+		finish_scene(scene);
+
+		scene.eye = vec3f(0.0f, 0.0f, 10.0f);
+		scene.target = vec3f(0.0f);
+	}
+	else
+	{
+		std::cout << "ERROR: Unknown scene: " << name << std::endl;
+		return false;
+	}
+
+	scene.triangle_count = uint32_t(scene.model.index_buffer.indices.size() / 3);
+
+	return true;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static void record_frame(BenchScene& scene, uint32_t frame, uint32_t width, uint32_t height, rst::Texture* color_tex, rst::Texture* depth_tex, rst::CommandList& commands)
+{
+	mat4f view = lookat(scene.eye, scene.target, vec3f(0.0f, 1.0f, 0.0f));
+	mat4f projection = perspective(float(width) / float(height), radians(60.0f), 0.1f, 1000.0f);
+
+	commands.reset();
+
+	commands.set_directional_lights(1, &scene.dir_light);
+
+	if (!scene.point_lights.empty())
+		commands.set_point_lights(uint32_t(scene.point_lights.size()), scene.point_lights.data());
+
+	commands.set_render_target(color_tex, depth_tex);
+	commands.set_vertex_buffer(&scene.model.vertex_buffer);
+	commands.set_index_buffer(&scene.model.index_buffer);
+	commands.set_projection_matrix(projection);
+	commands.set_view_matrix(view);
+	commands.set_model_matrix(rotation(radians(frame * scene.rotation_speed), vec3f(0.0f, 1.0f, 0.0f)));
+
+	for (const auto& submodel : scene.model.submodels)
+	{
+		rst::Material* material = submodel.material;
+
+		commands.set_texture(rst::TEXTURE_DIFFUSE, material ? material->diffuse : nullptr);
+		commands.set_texture(rst::TEXTURE_NORMAL, material ? material->normal : nullptr);
+		commands.set_texture(rst::TEXTURE_SPECULAR, material ? material->specular : nullptr);
+
+		commands.draw_indexed_base_vertex(submodel.index_count, submodel.base_index, submodel.base_vertex);
+	}
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static BenchResult run_benchmark(BenchScene& scene, uint32_t width, uint32_t height, uint32_t threads, uint32_t frames, uint32_t warmup)
+{
+	rst::Texture color_tex(width, height, false, rst::TEXTURE_LAYOUT_TILED);
+	rst::Texture depth_tex(width, height, true, rst::TEXTURE_LAYOUT_TILED);
+	std::vector<uint32_t> framebuffer(width * height);
+
+	rst::Context context;
+	rst::CommandList commands;
+
+	context.set_thread_count(threads);
+
+	uint64_t clear_ns = 0;
+	uint64_t resolve_ns = 0;
+	uint64_t frame_ns = 0;
+
+	for (uint32_t i = 0; i < warmup + frames; i++)
+	{
+		// Start measuring once the caches and allocations are warm
+		if (i == warmup)
+		{
+			context.reset_stage_timings();
+
+			clear_ns = 0;
+			resolve_ns = 0;
+			frame_ns = 0;
+		}
+
+		record_frame(scene, i, width, height, &color_tex, &depth_tex, commands);
+
+		auto start = std::chrono::steady_clock::now();
+
+		depth_tex.clear();
+		color_tex.clear(0.0f, 0.0f, 0.0f, 1.0f);
+
+		auto cleared = std::chrono::steady_clock::now();
+
+		context.submit(commands);
+
+		auto rendered = std::chrono::steady_clock::now();
+
+		color_tex.resolve(framebuffer.data(), width * sizeof(uint32_t));
+
+		auto end = std::chrono::steady_clock::now();
+
+		clear_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(cleared - start).count();
+		resolve_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(end - rendered).count();
+		frame_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+	}
+
+	const rst::StageTimings& timings = context.stage_timings();
+
+	BenchResult result;
+
+	result.scene = scene.name;
+	result.width = width;
+	result.height = height;
+	result.threads = threads;
+	result.frames = frames;
+	result.triangles = scene.triangle_count;
+	result.clear_ns = double(clear_ns) / frames;
+	result.vertex_ns = double(timings.vertex) / frames;
+	result.setup_ns = double(timings.setup) / frames;
+	result.raster_ns = double(timings.raster) / frames;
+	result.resolve_ns = double(resolve_ns) / frames;
+	result.frame_ns = double(frame_ns) / frames;
+
+	return result;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static void write_csv(std::ostream& out, const std::vector<BenchResult>& results)
+{
+	out << "scene,width,height,threads,frames,triangles,clear_ns,vertex_ns,setup_ns,raster_ns,resolve_ns,frame_ns,frames_per_sec,triangles_per_sec,pixels_per_sec" << std::endl;
+
+	for (const auto& result : results)
+	{
+		double fps = 1e9 / result.frame_ns;
+
+		out << result.scene << ","
+			<< result.width << ","
+			<< result.height << ","
+			<< result.threads << ","
+			<< result.frames << ","
+			<< result.triangles << ","
+			<< uint64_t(result.clear_ns) << ","
+			<< uint64_t(result.vertex_ns) << ","
+			<< uint64_t(result.setup_ns) << ","
+			<< uint64_t(result.raster_ns) << ","
+			<< uint64_t(result.resolve_ns) << ","
+			<< uint64_t(result.frame_ns) << ","
+			<< fps << ","
+			<< fps * result.triangles << ","
+			<< fps * result.width * result.height << std::endl;
+	}
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static void write_json(std::ostream& out, const std::vector<BenchResult>& results)
+{
+	out << "[" << std::endl;
+
+	for (size_t i = 0; i < results.size(); i++)
+	{
+		const BenchResult& result = results[i];
+		double fps = 1e9 / result.frame_ns;
+
+		out << "  {"
+			<< "\"scene\": \"" << result.scene << "\", "
+			<< "\"width\": " << result.width << ", "
+			<< "\"height\": " << result.height << ", "
+			<< "\"threads\": " << result.threads << ", "
+			<< "\"frames\": " << result.frames << ", "
+			<< "\"triangles\": " << result.triangles << ", "
+			<< "\"clear_ns\": " << uint64_t(result.clear_ns) << ", "
+			<< "\"vertex_ns\": " << uint64_t(result.vertex_ns) << ", "
+			<< "\"setup_ns\": " << uint64_t(result.setup_ns) << ", "
+			<< "\"raster_ns\": " << uint64_t(result.raster_ns) << ", "
+			<< "\"resolve_ns\": " << uint64_t(result.resolve_ns) << ", "
+			<< "\"frame_ns\": " << uint64_t(result.frame_ns) << ", "
+			<< "\"frames_per_sec\": " << fps << ", "
+			<< "\"triangles_per_sec\": " << fps * result.triangles << ", "
+			<< "\"pixels_per_sec\": " << fps * result.width * result.height
+			<< "}" << (i + 1 < results.size() ? "," : "") << std::endl;
+	}
+
+	out << "]" << std::endl;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+int main(int argc, char* argv[])
+{
+	std::string scene_list = "teapot,highpoly,lights,overdraw";
+	std::string resolution_list = "1280x720,1920x1080";
+	std::string thread_list = "1,0";
+	std::string format = "csv";
+	std::string output;
+	std::string trace;
+	uint32_t frames = 30;
+	uint32_t warmup = 3;
+
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		size_t separator = arg.find('=');
+		std::string key = arg.substr(0, separator);
+		std::string value = separator == std::string::npos ? "" : arg.substr(separator + 1);
+
+		if (key == "--scenes")
+			scene_list = value;
+		else if (key == "--resolutions")
+			resolution_list = value;
+		else if (key == "--threads")
+			thread_list = value;
+		else if (key == "--frames")
+			frames = atoi(value.c_str());
+		else if (key == "--warmup")
+			warmup = atoi(value.c_str());
+		else if (key == "--format")
+			format = value;
+		else if (key == "--output")
+			output = value;
+		else if (key == "--trace")
+			trace = value;
+		else
+		{
+			std::cout << "usage: rasterator_bench [--scenes=teapot,highpoly,lights,overdraw] [--resolutions=1280x720,1920x1080] [--threads=1,0] [--frames=30] [--warmup=3] [--format=csv|json] [--output=file] [--trace=file]" << std::endl;
+			return 1;
+		}
+	}
+
+	if (frames == 0 || (format != "csv" && format != "json"))
+	{
+		std::cout << "ERROR: Invalid frame count or format!" << std::endl;
+		return 1;
+	}
+
+	std::vector<std::pair<uint32_t, uint32_t>> resolutions;
+
+	for (const auto& resolution : split(resolution_list, ','))
+	{
+		uint32_t width = 0;
+		uint32_t height = 0;
+
+		if (sscanf(resolution.c_str(), "%ux%u", &width, &height) != 2 || width == 0 || height == 0)
+		{
+			std::cout << "ERROR: Invalid resolution: " << resolution << std::endl;
+			return 1;
+		}
+
+		resolutions.push_back(std::make_pair(width, height));
+	}
+
+	std::vector<uint32_t> thread_counts;
+
+	for (const auto& threads : split(thread_list, ','))
+	{
+		uint32_t count = atoi(threads.c_str());
+
+		// Resolve 'all' up front so the reported count is the one used
+		if (count == 0)
+			count = std::max(std::thread::hardware_concurrency(), 1u);
+
+		thread_counts.push_back(count);
+	}
+
+	std::vector<BenchResult> results;
+
+	if (!trace.empty())
+	{
+		rst::set_profiler_thread_name("Main");
+		rst::set_profiling_enabled(true);
+	}
+
+	for (const auto& name : split(scene_list, ','))
+	{
+		std::unique_ptr<BenchScene> scene(new BenchScene());
+
+		if (!create_scene(name, *scene))
+			return 1;
+
+		for (const auto& resolution : resolutions)
+		{
+			for (uint32_t threads : thread_counts)
+				results.push_back(run_benchmark(*scene, resolution.first, resolution.second, threads, frames, warmup));
+		}
+	}
+
+	std::ofstream file;
+
+	if (!output.empty())
+	{
+		file.open(output);
+
+		if (!file.is_open())
+		{
+			std::cout << "ERROR: Failed to open output file: " << output << std::endl;
+			return 1;
+		}
+	}
+
+	std::ostream& out = output.empty() ? std::cout : file;
+
+	if (format == "json")
+		write_json(out, results);
+	else
+		write_csv(out, results);
+
+	if (!trace.empty() && !rst::save_trace(trace))
+		return 1;
+
+	return 0;
+}
@@ -0,0 +1,92 @@
+#include <rasterator.hpp>
+#include <math/transform.hpp>
+#include <math/utility.hpp>
+
+#include <iostream>
+#include <chrono>
+#include <stdlib.h>
+
+// Renders the sample scene offscreen, without a window, and reports the rendering throughput.
+//
+// Usage: headless [width] [height] [frames] [output]
+
+int main(int argc, char* argv[])
+{
+	uint32_t width = argc > 1 ? atoi(argv[1]) : 1280;
+	uint32_t height = argc > 2 ? atoi(argv[2]) : 720;
+	uint32_t frames = argc > 3 ? atoi(argv[3]) : 100;
+	std::string output = argc > 4 ? argv[4] : "headless.png";
+
+	if (width == 0 || height == 0 || frames == 0)
+	{
+		std::cout << "usage: headless [width] [height] [frames] [output]" << std::endl;
+		return 1;
+	}
+
+	rst::Model model;
+
+	if (!rst::create_model("teapot.obj", model))
+	{
+		std::cout << "failed to load mesh" << std::endl;
+		return 1;
+	}
+
+	rst::Texture color_tex(width, height, false, rst::TEXTURE_LAYOUT_TILED);
+	rst::Texture depth_tex(width, height, true, rst::TEXTURE_LAYOUT_TILED);
+
+	vec3f position = vec3f(0.0f, 35.0f, 150.0f);
+	vec3f direction = vec3f(0.0f, 0.0f, -1.0f);
+
+	mat4f view = lookat(position, position + direction, vec3f(0.0f, 1.0f, 0.0f));
+	mat4f projection = perspective(float(width) / float(height), radians(60.0f), 0.1f, 1000.0f);
+
+	rst::DirectionalLight dir_light;
+
+	dir_light.color = vec3f(1.0f, 1.0f, 1.0f);
+	dir_light.direction = vec3f(1.0f, -1.0f, 0.0f).normalize();
+
+	rst::Context context;
+	rst::CommandList commands;
+
+	auto start = std::chrono::high_resolution_clock::now();
+
+	for (uint32_t i = 0; i < frames; i++)
+	{
+		depth_tex.clear();
+		color_tex.clear(0.0f, 0.0f, 0.0f, 1.0f);
+
+		commands.reset();
+
+		commands.set_directional_lights(1, &dir_light);
+		commands.set_render_target(&color_tex, &depth_tex);
+		commands.set_vertex_buffer(&model.vertex_buffer);
+		commands.set_index_buffer(&model.index_buffer);
+		commands.set_projection_matrix(projection);
+		commands.set_view_matrix(view);
+		commands.set_model_matrix(rotation(radians(i * 2.0f), vec3f(0.0f, 1.0f, 0.0f)));
+
+		for (const auto& submodel : model.submodels)
+		{
+			if (submodel.material)
+			{
+				commands.set_texture(rst::TEXTURE_DIFFUSE, submodel.material->diffuse);
+				commands.set_texture(rst::TEXTURE_NORMAL, submodel.material->normal);
+				commands.set_texture(rst::TEXTURE_SPECULAR, submodel.material->specular);
+			}
+
+			commands.draw_indexed_base_vertex(submodel.index_count, submodel.base_index, submodel.base_vertex);
+		}
+
+		context.submit(commands);
+	}
+
+	auto end = std::chrono::high_resolution_clock::now();
+	double ms = std::chrono::duration<double, std::milli>(end - start).count();
+
+	std::cout << frames << " frames in " << ms << " ms, " << frames * 1000.0 / ms << " fps" << std::endl;
+
+	if (!color_tex.save(output))
+		return 1;
+
+	return 0;
+}
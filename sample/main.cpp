@@ -7,6 +7,10 @@
 #include <iostream>
 #include <climits>
 #include <algorithm>
+#include <chrono>
+
+// Render target sets in flight: one is presented while the next renders.
+static const uint32_t kFrameCount = 2;
 
 class Demo : public Application
 {
@@ -21,8 +25,12 @@ class Demo : public Application
 	rst::DirectionalLight m_dir_light;
 	rst::PointLight m_point_light;
 	rst::Model m_obj_model;
-	std::unique_ptr<rst::Texture> m_color_tex;
-	std::unique_ptr<rst::Texture> m_depth_tex;
+	std::unique_ptr<rst::Texture> m_color_tex[kFrameCount];
+	std::unique_ptr<rst::Texture> m_depth_tex[kFrameCount];
+	rst::CommandList m_commands;
+
+	// Drives the rotation from the render thread, which must not call into SDL
+	std::chrono::steady_clock::time_point m_start_time;
 
 private:
 
@@ -30,16 +38,28 @@ private:
 protected:
 	bool initialize() override
 	{
-		m_color_tex = std::make_unique<rst::Texture>(m_width, m_height);
-		m_depth_tex = std::make_unique<rst::Texture>(m_width, m_height, true);
+		for (uint32_t i = 0; i < kFrameCount; i++)
+		{
+			m_color_tex[i] = std::make_unique<rst::Texture>(m_width, m_height, false, rst::TEXTURE_LAYOUT_TILED);
+			m_depth_tex[i] = std::make_unique<rst::Texture>(m_width, m_height, true, rst::TEXTURE_LAYOUT_TILED);
+		}
 
 		m_position = vec3f(0.0f, 35.0f, 150.0f);
 		m_direction = vec3f(0.0f, 0.0f, -1.0f);
 
 		m_view = lookat(m_position, m_position + m_direction, vec3f(0.0f, 1.0f, 0.0f));
-		m_projection = perspective(float(m_width) / float(m_height), radians(60.0f), 0.1f, 100.0f);
+		m_projection = perspective(float(m_width) / float(m_height), radians(60.0f), 0.1f, 1000.0f);
 		m_vp = m_projection * m_view;
 
+		// Load assets relative to the executable
+		char* base_path = SDL_GetBasePath();
+
+		if (base_path)
+		{
+			rst::set_base_path(base_path);
+			SDL_free(base_path);
+		}
+
 		if (!rst::create_model("teapot.obj", m_obj_model))
 		{
 			std::cout << "failed to load mesh" << std::endl;
@@ -57,30 +77,41 @@ protected:
 		m_point_light.linear = 0.0014;
 		m_point_light.quadratic = 0.000007;
 
+		m_start_time = std::chrono::steady_clock::now();
+
+		set_pipelined_frames(kFrameCount);
+
 		return true;
 	}
 
-	void frame() override
+	// Runs on the render thread
+	void render(uint32_t index) override
 	{
-		m_depth_tex->clear();
-		m_color_tex->clear(0.0f, 0.0f, 0.0f, 1.0f);
+		rst::Texture* color_tex = m_color_tex[index].get();
+		rst::Texture* depth_tex = m_depth_tex[index].get();
+
+		depth_tex->clear();
+		color_tex->clear(0.0f, 0.0f, 0.0f, 1.0f);
 
-		m_model = rotation(radians(SDL_GetTicks() * 0.05f), vec3f(0.0f, 1.0f, 0.0f));
+		float elapsed_ms = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - m_start_time).count();
+		m_model = rotation(radians(elapsed_ms * 0.05f), vec3f(0.0f, 1.0f, 0.0f));
+
+		m_commands.reset();
 
 		// Set lights
-		rst::set_directional_lights(1, &m_dir_light);
+		m_commands.set_directional_lights(1, &m_dir_light);
 
 		// Set render targets
-		rst::set_render_target(m_color_tex.get(), m_depth_tex.get());
+		m_commands.set_render_target(color_tex, depth_tex);
 
 		// Set buffers
-		rst::set_vertex_buffer(&m_obj_model.vertex_buffer);
-		rst::set_index_buffer(&m_obj_model.index_buffer);
+		m_commands.set_vertex_buffer(&m_obj_model.vertex_buffer);
+		m_commands.set_index_buffer(&m_obj_model.index_buffer);
 
 		// Set matrices
-		rst::set_projection_matrix(m_projection);
-		rst::set_view_matrix(m_view);
-		rst::set_model_matrix(m_model);
+		m_commands.set_projection_matrix(m_projection);
+		m_commands.set_view_matrix(m_view);
+		m_commands.set_model_matrix(m_model);
 
 		// For each submodel in model...
 		for (const auto& submodel : m_obj_model.submodels)
@@ -88,16 +119,31 @@ protected:
 			// Bind material, if available
 			if (submodel.material)
 			{
-				rst::set_texture(rst::TEXTURE_DIFFUSE, submodel.material->diffuse);
-				rst::set_texture(rst::TEXTURE_NORMAL, submodel.material->normal);
-				rst::set_texture(rst::TEXTURE_SPECULAR, submodel.material->specular);
+				m_commands.set_texture(rst::TEXTURE_DIFFUSE, submodel.material->diffuse);
+				m_commands.set_texture(rst::TEXTURE_NORMAL, submodel.material->normal);
+				m_commands.set_texture(rst::TEXTURE_SPECULAR, submodel.material->specular);
 			}
 
 			// Draw each submodel
-			rst::draw_indexed_base_vertex(submodel.index_count, submodel.base_index, submodel.base_vertex);
+			m_commands.draw_indexed_base_vertex(submodel.index_count, submodel.base_index, submodel.base_vertex);
 		}
 
-		update_backbuffer(m_color_tex->m_pixels);
+		// Render all submodels in one batch
+		rst::submit(m_commands);
+	}
+
+	// Runs on the main thread, while the next frame renders
+	void present(uint32_t index) override
+	{
+		uint32_t pitch;
+		void* pixels = lock_backbuffer(pitch);
+
+		if (!pixels)
+			return;
+
+		// Detile the color target straight into the streaming texture
+		m_color_tex[index]->resolve(pixels, pitch);
+		unlock_backbuffer();
 	}
 
 	void shutdown() override
@@ -1,4 +1,5 @@
 #include <application.hpp>
+#include <profiler.hpp>
 #include <stdio.h>
 #include <iostream>
 
@@ -8,8 +9,12 @@
 
 Application::Application() : m_is_running(false),
                              m_sdl_window(nullptr),
-							 m_delta_time(0), 
 							 m_last_delta_time(0),
+							 m_toggle_trace(false),
+							 m_pipelined_frames(0),
+							 m_free_slots(0),
+							 m_render_exit(false),
+							 m_delta_time(0), 
 #ifdef __EMSCRIPTEN__
 							 m_width(640),
 							 m_height(360)
@@ -54,13 +59,128 @@ void Application::_main_loop(void* arg)
 
 void Application::_frame()
 {
-	_clear_screen(0, 0, 0, 255);
-    _event_loop();
+	{
+		RST_PROFILE_SCOPE("Frame");
+
+		{
+			RST_PROFILE_SCOPE("Clear Screen");
+			_clear_screen(0, 0, 0, 255);
+		}
+
+		{
+			RST_PROFILE_SCOPE("Events");
+			_event_loop();
+		}
+
+		if (m_pipelined_frames == 0)
+		{
+			RST_PROFILE_SCOPE("Frame Callback");
+			frame();
+		}
+		else
+		{
+#ifdef __EMSCRIPTEN__
+			// No threads, so render and present each frame in turn
+			{
+				RST_PROFILE_SCOPE("Render");
+				render(0);
+			}
+
+			{
+				RST_PROFILE_SCOPE("Present Callback");
+				present(0);
+			}
+#else
+			uint32_t index;
+
+			// Wait for the oldest rendered slot
+			{
+				RST_PROFILE_SCOPE("Wait For Render");
+
+				std::unique_lock<std::mutex> lock(m_render_mutex);
+				m_render_cv.wait(lock, [this] { return !m_ready_slots.empty(); });
+
+				index = m_ready_slots.front();
+				m_ready_slots.pop_front();
+			}
+
+			{
+				RST_PROFILE_SCOPE("Present Callback");
+				present(index);
+			}
+
+			// Hand the slot back to the render thread
+			{
+				std::lock_guard<std::mutex> lock(m_render_mutex);
+				m_free_slots++;
+			}
+
+			m_render_cv.notify_all();
+#endif
+		}
+
+		_update_delta_time();
+
+		{
+			RST_PROFILE_SCOPE("Present");
+			_present();
+		}
+	}
+
+	// Outside the frame's scopes, so they are recorded before the trace is saved
+	if (m_toggle_trace)
+	{
+		m_toggle_trace = false;
+		_toggle_trace();
+	}
+}
+
+void Application::_render_loop()
+{
+#ifndef __EMSCRIPTEN__
+	uint32_t index = 0;
+
+	rst::set_profiler_thread_name("Render");
+
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> lock(m_render_mutex);
+			m_render_cv.wait(lock, [this] { return m_render_exit || m_free_slots > 0; });
+
+			if (m_render_exit)
+				return;
+
+			m_free_slots--;
+		}
+
+		{
+			RST_PROFILE_SCOPE("Render");
+			render(index);
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(m_render_mutex);
+			m_ready_slots.push_back(index);
+		}
 
-	frame();
+		m_render_cv.notify_all();
 
-	_update_delta_time();
-	_present();
+		index = (index + 1) % m_pipelined_frames;
+	}
+#endif
+}
+
+void Application::set_pipelined_frames(uint32_t count)
+{
+	if (count == 1 || count > 3)
+	{
+		std::cout << "ERROR: Pipelined frames need 2 or 3 slots!" << std::endl;
+		return;
+	}
+
+	m_pipelined_frames = count;
+	m_free_slots = count;
 }
 
 void Application::_update_delta_time()
@@ -103,10 +223,17 @@ bool Application::_initialize()
         return false;
 
 	m_sdl_renderer = SDL_CreateRenderer(m_sdl_window, -1, SDL_RENDERER_ACCELERATED);
-	m_sdl_backbuffer = SDL_CreateTexture(m_sdl_renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STATIC, m_width, m_height);
+	m_sdl_backbuffer = SDL_CreateTexture(m_sdl_renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING, m_width, m_height);
+
+	rst::set_profiler_thread_name("Main");
 
 	if (!initialize())
 		return false;
+
+#ifndef __EMSCRIPTEN__
+	if (m_pipelined_frames > 0)
+		m_render_thread = std::thread(&Application::_render_loop, this);
+#endif
 	
 	m_is_running = true;
     return true;
@@ -114,6 +241,20 @@ bool Application::_initialize()
 
 void Application::_shutdown()
 {
+#ifndef __EMSCRIPTEN__
+	// Let the render thread finish the frame it is on
+	if (m_render_thread.joinable())
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_render_mutex);
+			m_render_exit = true;
+		}
+
+		m_render_cv.notify_all();
+		m_render_thread.join();
+	}
+#endif
+
 	shutdown();
 
 	SDL_DestroyTexture(m_sdl_backbuffer);
@@ -152,7 +293,9 @@ void Application::_event_loop()
             {
                 if(event.key.repeat == 0)
                 {
-
+					// F12 starts recording a trace, and a second press saves it at the end of the frame
+					if (event.type == SDL_KEYDOWN && event.key.keysym.sym == SDLK_F12)
+						m_toggle_trace = true;
                 }
                 break;
             }
@@ -167,8 +310,51 @@ void Application::_event_loop()
     }
 }
 
+void Application::_toggle_trace()
+{
+	if (!rst::profiling_enabled())
+	{
+		std::cout << "Recording trace..." << std::endl;
+		rst::set_profiling_enabled(true);
+	}
+	else
+	{
+		rst::set_profiling_enabled(false);
+
+#ifndef __EMSCRIPTEN__
+		// Wait for the render thread to fill every slot and go idle, so no other thread is still recording
+		std::unique_lock<std::mutex> lock(m_render_mutex);
+		m_render_cv.wait(lock, [this] { return m_ready_slots.size() == m_pipelined_frames; });
+#endif
+
+		if (rst::save_trace("trace.json"))
+			std::cout << "Saved trace to trace.json" << std::endl;
+	}
+}
+
 void Application::update_backbuffer(void* pixels)
 {
 	SDL_UpdateTexture(m_sdl_backbuffer, NULL, pixels, m_width * sizeof(uint32_t));
 	SDL_RenderCopy(m_sdl_renderer, m_sdl_backbuffer, NULL, NULL);
 }
+
+void* Application::lock_backbuffer(uint32_t& pitch)
+{
+	void* pixels = nullptr;
+	int row_pitch = 0;
+
+	if (SDL_LockTexture(m_sdl_backbuffer, NULL, &pixels, &row_pitch) != 0)
+	{
+		std::cout << "ERROR: Failed to lock backbuffer: " << SDL_GetError() << std::endl;
+		return nullptr;
+	}
+
+	pitch = row_pitch;
+	return pixels;
+}
+
+void Application::unlock_backbuffer()
+{
+	SDL_UnlockTexture(m_sdl_backbuffer);
+	SDL_RenderCopy(m_sdl_renderer, m_sdl_backbuffer, NULL, NULL);
+}
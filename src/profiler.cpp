@@ -0,0 +1,184 @@
+#include <profiler.hpp>
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <algorithm>
+#include <chrono>
+
+namespace rst
+{
+	// Events kept per thread. Older events are overwritten once a thread records more than this.
+	static const uint32_t kProfileEventCount = 1 << 16;
+
+	struct ProfileEvent
+	{
+		const char* name;
+		uint64_t	start;
+		uint64_t	duration;
+	};
+
+	// Written only by its owning thread. 'head' counts every event ever recorded; the last kProfileEventCount of them are
+	// in the ring. 'saved' is the head at the last save_trace(), which owns it, so saving never writes to a ring that
+	// another thread may be recording into.
+	struct ProfileThread
+	{
+		uint32_t				  id;
+		const char*				  name;
+		std::atomic<uint64_t>	  head;
+		uint64_t				  saved;
+		std::vector<ProfileEvent> events;
+	};
+
+	static std::atomic<bool> g_profiling(false);
+
+	// Every thread that ever recorded an event. Threads only take the lock to register on their first event.
+	static std::mutex g_profile_mutex;
+	static std::vector<std::unique_ptr<ProfileThread>> g_profile_threads;
+
+	static thread_local ProfileThread* g_profile_thread = nullptr;
+
+	// -----------------------------------------------------------------------------------------------------------------------------------
+
+	// Nanoseconds since the first call.
+	static uint64_t profile_time()
+	{
+		static const std::chrono::steady_clock::time_point kEpoch = std::chrono::steady_clock::now();
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - kEpoch).count();
+	}
+
+	// -----------------------------------------------------------------------------------------------------------------------------------
+
+	static ProfileThread* profile_thread()
+	{
+		if (!g_profile_thread)
+		{
+			std::unique_ptr<ProfileThread> thread(new ProfileThread());
+
+			thread->name = nullptr;
+			thread->head = 0;
+			thread->saved = 0;
+			thread->events.resize(kProfileEventCount);
+
+			std::lock_guard<std::mutex> lock(g_profile_mutex);
+
+			thread->id = uint32_t(g_profile_threads.size());
+			g_profile_thread = thread.get();
+			g_profile_threads.push_back(std::move(thread));
+		}
+
+		return g_profile_thread;
+	}
+
+	// -----------------------------------------------------------------------------------------------------------------------------------
+
+	ProfileScope::ProfileScope(const char* name) : m_name(nullptr), m_start(0)
+	{
+		if (g_profiling.load(std::memory_order_relaxed))
+		{
+			m_name = name;
+			m_start = profile_time();
+		}
+	}
+
+	// -----------------------------------------------------------------------------------------------------------------------------------
+
+	ProfileScope::~ProfileScope()
+	{
+		// Scopes still open when recording stops are dropped, so they don't end up in the next trace
+		if (!m_name || !g_profiling.load(std::memory_order_relaxed))
+			return;
+
+		uint64_t end = profile_time();
+		ProfileThread* thread = profile_thread();
+		uint64_t head = thread->head.load(std::memory_order_relaxed);
+
+		ProfileEvent& event = thread->events[head % kProfileEventCount];
+
+		event.name = m_name;
+		event.start = m_start;
+		event.duration = end - m_start;
+
+		thread->head.store(head + 1, std::memory_order_release);
+	}
+
+	// -----------------------------------------------------------------------------------------------------------------------------------
+
+	void set_profiling_enabled(bool enable)
+	{
+		// Start the clock, so the first events don't pay for it
+		profile_time();
+
+		g_profiling = enable;
+	}
+
+	// -----------------------------------------------------------------------------------------------------------------------------------
+
+	bool profiling_enabled()
+	{
+		return g_profiling;
+	}
+
+	// -----------------------------------------------------------------------------------------------------------------------------------
+
+	void set_profiler_thread_name(const char* name)
+	{
+		profile_thread()->name = name;
+	}
+
+	// -----------------------------------------------------------------------------------------------------------------------------------
+
+	bool save_trace(const std::string& file)
+	{
+		std::ofstream out(file);
+
+		if (!out.is_open())
+		{
+			std::cout << "ERROR: Failed to open trace file: " << file << std::endl;
+			return false;
+		}
+
+		std::lock_guard<std::mutex> lock(g_profile_mutex);
+
+		out << std::fixed << std::setprecision(3) << "{\"traceEvents\":[" << std::endl;
+
+		bool first = true;
+
+		for (auto& thread : g_profile_threads)
+		{
+			uint64_t head = thread->head.load(std::memory_order_acquire);
+			uint64_t count = std::min(head - thread->saved, uint64_t(kProfileEventCount));
+
+			if (count == 0 && !thread->name)
+				continue;
+
+			out << (first ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << thread->id << ",\"args\":{\"name\":\"";
+
+			if (thread->name)
+				out << thread->name;
+			else
+				out << "Thread " << thread->id;
+
+			out << "\"}}";
+			first = false;
+
+			// Timestamps are in microseconds
+			for (uint64_t i = head - count; i < head; i++)
+			{
+				const ProfileEvent& event = thread->events[i % kProfileEventCount];
+
+				out << ",\n{\"name\":\"" << event.name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << thread->id
+					<< ",\"ts\":" << event.start / 1000.0 << ",\"dur\":" << event.duration / 1000.0 << "}";
+			}
+
+			thread->saved = head;
+		}
+
+		out << std::endl << "]}" << std::endl;
+
+		return true;
+	}
+}
@@ -1,8 +1,14 @@
 #include <rasterator.hpp>
+#include <pipeline.hpp>
+#include <profiler.hpp>
+#include <math/simd_int8.hpp>
+#include <math/simd_mat4x8.hpp>
 #include <iostream>
 #include <stdio.h>
+#include <string.h>
 #include <algorithm>
 #include <unordered_map>
+#include <chrono>
 
 #include <assimp/Importer.hpp>
 #include <assimp/scene.h>
@@ -11,23 +17,291 @@
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
 
-#include <SDL.h>
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include <stb_image_write.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 namespace rst
 {
-	// Global state.
-	VertexBuffer*	  g_current_vb = nullptr;
-	IndexBuffer*	  g_current_ib = nullptr;
-	Texture*		  g_current_color_target = nullptr;
-	Texture*		  g_current_depth_target = nullptr;
-	Texture*		  g_current_textures[3];
-	mat4f			  g_current_model_mat;
-	mat4f			  g_current_view_mat;
-	mat4f			  g_current_projection_mat;
-	uint32_t		  g_dir_light_count = 0;
-	DirectionalLight* g_current_dir_lights = nullptr;
-	uint32_t		  g_point_light_count = 0;
-	PointLight*		  g_current_point_lights = nullptr;
+	// Directory that file names are relative to.
+	static std::string g_base_path;
+
+	// Sub-pixel precision of the fixed point screen coordinates used for rasterization.
+	static const int32_t kSubpixelBits = 8;
+	static const int32_t kSubpixelStep = 1 << kSubpixelBits;
+
+	// Largest screen coordinate (in pixels) a vertex may have. Keeps the edge function steps across a tile within 32 bits.
+	static const float kMaxScreenCoord = 8192.0f;
+
+	// Vertices further off-screen than this (in pixels) are clipped to it. Kept inside kMaxScreenCoord to leave room for
+	// rounding, and well outside any render target so that clipping is only needed in rare cases.
+	static const float kGuardBand = 8000.0f;
+
+	// A triangle clipped against the near plane and the four guard band planes has at most 8 vertices.
+	static const uint32_t kMaxClipVertices = 8;
+
+	// Clip codes, one per frustum and guard band plane.
+	enum ClipCode
+	{
+		CLIP_LEFT			   = 1 << 0,
+		CLIP_RIGHT			   = 1 << 1,
+		CLIP_BOTTOM			   = 1 << 2,
+		CLIP_TOP			   = 1 << 3,
+		CLIP_NEAR			   = 1 << 4,
+		CLIP_FAR			   = 1 << 5,
+		CLIP_GUARD_BAND_LEFT   = 1 << 6,
+		CLIP_GUARD_BAND_RIGHT  = 1 << 7,
+		CLIP_GUARD_BAND_BOTTOM = 1 << 8,
+		CLIP_GUARD_BAND_TOP	   = 1 << 9,
+		CLIP_REQUIRED		   = CLIP_NEAR | CLIP_GUARD_BAND_LEFT | CLIP_GUARD_BAND_RIGHT | CLIP_GUARD_BAND_BOTTOM | CLIP_GUARD_BAND_TOP
+	};
+
+	// Point lights are treated as out of reach where their attenuation falls below this, i.e. where they would change an
+	// 8-bit color channel by less than one step.
+	static const float kLightCutoff = 1.0f / 256.0f;
+
+	// Light count bucket of pipelines that loop over however many lights are bound.
+	static const int32_t kDynamicLightCount = -1;
+
+	// Triangles set up by one front-end job, along with per-tile lists of indices into them.
+	struct Bin
+	{
+		std::vector<TriangleSetup>		   triangles;
+		std::vector<uint32_t>			   draws;
+		std::vector<std::vector<uint32_t>> tiles;
+	};
+
+	// Feature set a raster and shade kernel is specialized on. Features that are off compile out of the inner loops.
+	template<bool Textured, int32_t DirLights, bool PointLights, FilterMode Filter, bool DepthWrite>
+	struct PipelineState
+	{
+		static const bool		kTextured = Textured;
+		static const int32_t	kDirLights = DirLights;
+		static const bool		kPointLights = PointLights;
+		static const bool		kLit = DirLights != 0 || PointLights;
+		static const FilterMode kFilter = Filter;
+		static const bool		kDepthWrite = DepthWrite;
+	};
+
+	// Bound lights, repacked into SoA form when they are set.
+	struct DirectionalLightBuffer
+	{
+		// Negated, i.e. pointing towards the light
+		std::vector<float> direction[3];
+	};
+
+	struct PointLightBuffer
+	{
+		std::vector<float> position[3];
+		std::vector<float> constant;
+		std::vector<float> linear;
+		std::vector<float> quadratic;
+		std::vector<float> radius;
+	};
+
+	// Varyings of the built-in shading path.
+	enum Varying
+	{
+		VARYING_WORLD_POSITION = 0,
+		VARYING_NORMAL		   = 3,
+		VARYING_TEXCOORD	   = 6,
+		VARYING_COUNT		   = 8
+	};
+
+	// Post-transform vertices of the current draw in SoA form, indexed relative to the first vertex the draw references.
+	struct ClipVertexBuffer
+	{
+		std::vector<float>	  position[4];
+		std::vector<float>	  varyings[VARYING_COUNT];
+		std::vector<uint32_t> outcodes;
+	};
+
+	// Uniforms of the built-in shading path.
+	struct BuiltinShader
+	{
+		Texture*			   textures[3];
+		DirectionalLightBuffer dir_lights;
+		PointLightBuffer	   point_lights;
+		uint32_t			   dir_light_count;
+		uint32_t			   point_light_count;
+	};
+
+	// Shading state shared by consecutive draws of a batch, snapshotted whenever it changes.
+	struct DrawState
+	{
+		BuiltinShader builtin;
+		mat4f		  view_mat;
+		mat4f		  projection_mat;
+
+		// Per-tile point light lists, built when the batch is executed.
+		std::vector<std::vector<uint32_t>> tile_lights;
+	};
+
+	// A draw queued into the current batch, along with the state it was issued with.
+	struct DrawCall
+	{
+		// Vertices referenced by the draw, starting at the lowest index
+		const Vertex*	  vertices;
+		const uint32_t*	  indices;
+		uint32_t		  first_vertex;
+		uint32_t		  vertex_count;
+		uint32_t		  triangle_count;
+
+		// Offsets of the draw's vertices and triangles within the batch
+		uint32_t		  vertex_offset;
+		uint32_t		  triangle_offset;
+
+		mat4f			  model_mat;
+		mat4f			  vp_mat;
+		CullMode		  cull_mode;
+		FrontFace		  front_face;
+		bool			  shaded;
+		ShaderProgram	  shader_program;
+		uint32_t		  varying_count;
+		RasterizeFunction rasterize;
+		const void*		  shader;
+		uint32_t		  draw_state;
+	};
+
+	// Range of one draw's vertices transformed by a single vertex stage job.
+	struct VertexJob
+	{
+		uint32_t draw;
+		uint32_t first;
+		uint32_t count;
+	};
+
+	// Vertices per vertex stage job. A multiple of the SIMD width.
+	static const uint32_t kVertexJobSize = 1024;
+
+	// Everything a Context owns: the bound state, plus scratch memory reused from draw to draw.
+	struct ContextState
+	{
+		VertexBuffer* vb;
+		IndexBuffer*  ib;
+		Texture*	  color_target;
+		Texture*	  depth_target;
+		mat4f		  model_mat;
+		mat4f		  view_mat;
+		mat4f		  projection_mat;
+		CullMode	  cull_mode;
+		FrontFace	  front_face;
+		FilterMode	  filter_mode;
+		bool		  depth_write;
+		uint32_t	  thread_count;
+		BuiltinShader builtin;
+
+		// Kernel for the bound state, picked again on the first draw after any of the state it depends on changes.
+		RasterizeFunction rasterize;
+		bool			  pipeline_dirty;
+
+		// User shader, if one is bound.
+		ShaderProgram shader_program;
+		bool		  shader_bound;
+
+		// Draws queued since the last flush, and the shading states they use. Draw states are reused across batches to
+		// keep their allocations, so only the first 'draw_state_count' are live.
+		std::vector<DrawCall>  draws;
+		std::vector<DrawState> draw_states;
+		uint32_t			   draw_state_count;
+		bool				   draw_state_dirty;
+		uint32_t			   batch_vertex_count;
+		uint32_t			   batch_triangle_count;
+
+		std::vector<Bin>	   bins;
+		std::vector<VertexJob> vertex_jobs;
+
+		// Post-transform vertices of the built-in and of the user shader path.
+		ClipVertexBuffer		clip_vertices;
+		std::vector<ClipVertex> shader_vertices;
+
+		StageTimings timings;
+
+		// Counters of every thread for every draw of the batch, indexed by thread * draw count + draw, and the distinct
+		// pixels each thread covered in the batch.
+		bool							statistics_enabled;
+		std::vector<PipelineStatistics> thread_statistics;
+		std::vector<uint64_t>			thread_pixels_covered;
+		PipelineStatistics				statistics;
+		std::vector<PipelineStatistics> draw_statistics;
+	};
+
+	// Recorded commands. Variable sized arguments are stored in side arrays and referenced by index.
+	enum CommandType
+	{
+		COMMAND_SET_VERTEX_BUFFER = 0,
+		COMMAND_SET_INDEX_BUFFER,
+		COMMAND_SET_DIRECTIONAL_LIGHTS,
+		COMMAND_SET_POINT_LIGHTS,
+		COMMAND_SET_RENDER_TARGET,
+		COMMAND_SET_MODEL_MATRIX,
+		COMMAND_SET_VIEW_MATRIX,
+		COMMAND_SET_PROJECTION_MATRIX,
+		COMMAND_SET_CULL_MODE,
+		COMMAND_SET_FRONT_FACE,
+		COMMAND_SET_FILTER_MODE,
+		COMMAND_SET_DEPTH_WRITE,
+		COMMAND_SET_TEXTURE,
+		COMMAND_SET_SHADER_PROGRAM,
+		COMMAND_RESET_SHADER,
+		COMMAND_DRAW,
+		COMMAND_DRAW_INDEXED_BASE_VERTEX
+	};
+
+	struct Command
+	{
+		CommandType type;
+
+		union
+		{
+			VertexBuffer* vb;
+			IndexBuffer*  ib;
+			CullMode	  cull_mode;
+			FrontFace	  front_face;
+			FilterMode	  filter_mode;
+			bool		  enable;
+
+			// Index into the matrix or shader program array
+			uint32_t	  index;
+
+			struct
+			{
+				uint32_t first;
+				uint32_t count;
+			} lights;
+
+			struct
+			{
+				Texture* color;
+				Texture* depth;
+			} target;
+
+			struct
+			{
+				uint32_t type;
+				Texture* texture;
+			} texture;
+
+			struct
+			{
+				uint32_t count;
+				uint32_t base_index;
+				uint32_t base_vertex;
+			} draw;
+		};
+	};
+
+	struct CommandListData
+	{
+		std::vector<Command>		  commands;
+		std::vector<mat4f>			  matrices;
+		std::vector<DirectionalLight> dir_lights;
+		std::vector<PointLight>		  point_lights;
+		std::vector<ShaderProgram>	  shader_programs;
+	};
 
 	// -----------------------------------------------------------------------------------------------------------------------------------
 
@@ -69,16 +343,36 @@ namespace rst
 
 	// -----------------------------------------------------------------------------------------------------------------------------------
 
-	Texture::Texture(uint32_t width, uint32_t height, bool depth) : m_width(width), m_height(height)
+	Texture::Texture(uint32_t width, uint32_t height, bool depth, TextureLayout layout) : m_width(width), m_height(height), m_layout(layout)
 	{
+		m_block_min_depth = nullptr;
+		m_block_max_depth = nullptr;
+		m_tile_max_depth = nullptr;
+		m_mip_count = 1;
+		m_mip_offsets[0] = 0;
+
+		// Render target spans read and write 8 contiguous texels of a row, which a swizzled block row doesn't have
+		if (layout == TEXTURE_LAYOUT_SWIZZLED)
+		{
+			std::cout << "ERROR: Swizzled textures can only be made by swizzle()! Using the linear layout." << std::endl;
+			m_layout = TEXTURE_LAYOUT_LINEAR;
+		}
+
 		if (depth)
 		{
 			m_pixels = nullptr;
-			m_depth = new float[width * height];
+			m_depth = new float[texel_count()];
+
+			uint32_t block_count = ((width + kBlockSize - 1) / kBlockSize) * ((height + kBlockSize - 1) / kBlockSize);
+			uint32_t tile_count = ((width + kTileSize - 1) / kTileSize) * ((height + kTileSize - 1) / kTileSize);
+
+			m_block_min_depth = new float[block_count];
+			m_block_max_depth = new float[block_count];
+			m_tile_max_depth = new float[tile_count];
 		}
 		else
 		{
-			m_pixels = new Color[width * height];
+			m_pixels = new Color[texel_count()];
 			m_depth = nullptr;
 		}
 	}
@@ -89,15 +383,20 @@ namespace rst
 	{
 		int x, y, comp;
 
-        std::string base_path = SDL_GetBasePath();
-        std::string path = base_path + name;
+		std::string path = g_base_path + name;
 		Color* data = (Color*)stbi_load(path.c_str(), &x, &y, &comp, 4);
 
 		m_width = x;
 		m_height = y;
+		m_layout = TEXTURE_LAYOUT_LINEAR;
 
 		m_pixels = new Color[x * y];
 		m_depth = nullptr;
+		m_block_min_depth = nullptr;
+		m_block_max_depth = nullptr;
+		m_tile_max_depth = nullptr;
+		m_mip_count = 1;
+		m_mip_offsets[0] = 0;
 
 		int size = x * y;
 
@@ -108,6 +407,117 @@ namespace rst
 		}
 
 		stbi_image_free(data);
+
+		generate_mips();
+		swizzle();
+	}
+
+	// -----------------------------------------------------------------------------------------------------------------------------------
+
+	void Texture::generate_mips()
+	{
+		if (!m_pixels || m_layout != TEXTURE_LAYOUT_LINEAR)
+		{
+			std::cout << "ERROR: Mips can only be generated for linear color textures!" << std::endl;
+			return;
+		}
+
+		// Lay out every level down to 1x1
+		uint32_t offset = 0;
+
+		m_mip_count = 0;
+
+		for (uint32_t level = 0; level < kMaxMipLevels; level++)
+		{
+			uint32_t width = std::max(m_width >> level, 1u);
+			uint32_t height = std::max(m_height >> level, 1u);
+
+			m_mip_offsets[m_mip_count++] = offset;
+			offset += width * height;
+
+			if (width == 1 && height == 1)
+				break;
+		}
+
+		Color* pixels = new Color[offset];
+		memcpy(pixels, m_pixels, m_width * m_height * sizeof(Color));
+
+		delete[] m_pixels;
+		m_pixels = pixels;
+
+		// Each texel averages the 2x2 texels it covers in the level above, clamped at the edges of odd sized levels
+		for (uint32_t level = 1; level < m_mip_count; level++)
+		{
+			const uint8_t* src = (const uint8_t*)&m_pixels[m_mip_offsets[level - 1]];
+			uint8_t* dst = (uint8_t*)&m_pixels[m_mip_offsets[level]];
+
+			uint32_t src_width = std::max(m_width >> (level - 1), 1u);
+			uint32_t src_height = std::max(m_height >> (level - 1), 1u);
+			uint32_t width = std::max(m_width >> level, 1u);
+			uint32_t height = std::max(m_height >> level, 1u);
+
+			for (uint32_t y = 0; y < height; y++)
+			{
+				uint32_t y0 = std::min(y * 2, src_height - 1);
+				uint32_t y1 = std::min(y * 2 + 1, src_height - 1);
+
+				for (uint32_t x = 0; x < width; x++)
+				{
+					uint32_t x0 = std::min(x * 2, src_width - 1);
+					uint32_t x1 = std::min(x * 2 + 1, src_width - 1);
+
+					for (uint32_t c = 0; c < 4; c++)
+					{
+						uint32_t sum = src[(y0 * src_width + x0) * 4 + c] + src[(y0 * src_width + x1) * 4 + c] + src[(y1 * src_width + x0) * 4 + c] + src[(y1 * src_width + x1) * 4 + c];
+						dst[(y * width + x) * 4 + c] = uint8_t((sum + 2) / 4);
+					}
+				}
+			}
+		}
+	}
+
+	// -----------------------------------------------------------------------------------------------------------------------------------
+
+	void Texture::swizzle()
+	{
+		if (!m_pixels || m_layout != TEXTURE_LAYOUT_LINEAR)
+		{
+			std::cout << "ERROR: Only linear color textures can be swizzled!" << std::endl;
+			return;
+		}
+
+		Color* linear = m_pixels;
+		uint32_t linear_offsets[kMaxMipLevels];
+		memcpy(linear_offsets, m_mip_offsets, sizeof(m_mip_offsets));
+
+		// Pad every level to whole blocks
+		uint32_t offset = 0;
+
+		for (uint32_t level = 0; level < m_mip_count; level++)
+		{
+			uint32_t blocks_x = (std::max(m_width >> level, 1u) + kTexelBlockSize - 1) / kTexelBlockSize;
+			uint32_t blocks_y = (std::max(m_height >> level, 1u) + kTexelBlockSize - 1) / kTexelBlockSize;
+
+			m_mip_offsets[level] = offset;
+			offset += blocks_x * blocks_y * kTexelBlockSize * kTexelBlockSize;
+		}
+
+		m_pixels = new Color[offset];
+		m_layout = TEXTURE_LAYOUT_SWIZZLED;
+
+		for (uint32_t level = 0; level < m_mip_count; level++)
+		{
+			uint32_t width = std::max(m_width >> level, 1u);
+			uint32_t height = std::max(m_height >> level, 1u);
+
+			for (uint32_t y = 0; y < height; y++)
+			{
+				for (uint32_t x = 0; x < width; x++)
+					m_pixels[sample_offset(x, y, level)] = linear[linear_offsets[level] + y * width + x];
+			}
+		}
+
+		delete[] linear;
 	}
 
 	// -----------------------------------------------------------------------------------------------------------------------------------
@@ -116,6 +526,9 @@ namespace rst
 	{
 		RST_SAFE_DELETE_ARRAY(m_pixels);
 		RST_SAFE_DELETE_ARRAY(m_depth);
+		RST_SAFE_DELETE_ARRAY(m_block_min_depth);
+		RST_SAFE_DELETE_ARRAY(m_block_max_depth);
+		RST_SAFE_DELETE_ARRAY(m_tile_max_depth);
 	}
 
 	// -----------------------------------------------------------------------------------------------------------------------------------
@@ -132,7 +545,15 @@ namespace rst
 			if (y > m_height - 1 || y < 0)
 				return;
 
-			m_depth[y * m_width + x] = depth;
+			m_depth[texel_offset(x, y)] = depth;
+
+			// Widen the depth bounds of the enclosing block and tile so they stay conservative
+			uint32_t block = (y / kBlockSize) * ((m_width + kBlockSize - 1) / kBlockSize) + x / kBlockSize;
+			uint32_t tile = (y / kTileSize) * ((m_width + kTileSize - 1) / kTileSize) + x / kTileSize;
+
+			m_block_min_depth[block] = std::min(m_block_min_depth[block], depth);
+			m_block_max_depth[block] = std::max(m_block_max_depth[block], depth);
+			m_tile_max_depth[tile] = std::max(m_tile_max_depth[tile], depth);
 		}
 	}
 
@@ -140,8 +561,6 @@ namespace rst
 
 	void Texture::set_color(uint32_t color, uint32_t x, uint32_t y)
 	{
-		y = m_height - y - 1;
-
 		if (m_pixels)
 		{
 			if (x > m_width - 1)
@@ -150,9 +569,67 @@ namespace rst
 			if (y > m_height - 1)
 				return;
 
-			m_pixels[y * m_width + x] = color;
+			m_pixels[texel_offset(x, y)] = color;
 		}
 	}
+
+	// -----------------------------------------------------------------------------------------------------------------------------------
+
+	// Index of the texel at (x, y), with y increasing upwards as in the rasterizer.
+	uint32_t Texture::texel_offset(uint32_t x, uint32_t y) const
+	{
+		if (m_layout == TEXTURE_LAYOUT_TILED)
+		{
+			const uint32_t tiles_x = (m_width + kTileSize - 1) / kTileSize;
+			const uint32_t blocks_per_row = kTileSize / kBlockSize;
+
+			uint32_t tile = (y / kTileSize) * tiles_x + x / kTileSize;
+			uint32_t block = ((y % kTileSize) / kBlockSize) * blocks_per_row + (x % kTileSize) / kBlockSize;
+
+			return (tile * blocks_per_row * blocks_per_row + block) * kBlockSize * kBlockSize + (y % kBlockSize) * kBlockSize + x % kBlockSize;
+		}
+
+		if (m_layout == TEXTURE_LAYOUT_SWIZZLED)
+			return sample_offset(x, m_height - y - 1, 0);
+
+		// Linear color targets are stored top row first
+		if (m_pixels)
+			y = m_height - y - 1;
+
+		return y * m_width + x;
+	}
+
+	// -----------------------------------------------------------------------------------------------------------------------------------
+
+	// Index of the texel at (x, y) of a mip level, with y increasing downwards as in sample().
+	uint32_t Texture::sample_offset(uint32_t x, uint32_t y, uint32_t level) const
+	{
+		uint32_t width = std::max(m_width >> level, 1u);
+
+		if (m_layout == TEXTURE_LAYOUT_SWIZZLED)
+		{
+			uint32_t blocks_x = (width + kTexelBlockSize - 1) / kTexelBlockSize;
+			uint32_t block = (y / kTexelBlockSize) * blocks_x + x / kTexelBlockSize;
+
+			return m_mip_offsets[level] + block * kTexelBlockSize * kTexelBlockSize + (y % kTexelBlockSize) * kTexelBlockSize + x % kTexelBlockSize;
+		}
+
+		return m_mip_offsets[level] + y * width + x;
+	}
+
+	// -----------------------------------------------------------------------------------------------------------------------------------
+
+	// Number of texels allocated for level 0; tiled and swizzled textures are padded to whole tiles and blocks.
+	uint32_t Texture::texel_count() const
+	{
+		if (m_layout == TEXTURE_LAYOUT_TILED)
+			return ((m_width + kTileSize - 1) / kTileSize) * ((m_height + kTileSize - 1) / kTileSize) * kTileSize * kTileSize;
+
+		if (m_layout == TEXTURE_LAYOUT_SWIZZLED)
+			return ((m_width + kTexelBlockSize - 1) / kTexelBlockSize) * ((m_height + kTexelBlockSize - 1) / kTexelBlockSize) * kTexelBlockSize * kTexelBlockSize;
+
+		return m_width * m_height;
+	}
     
 	// -----------------------------------------------------------------------------------------------------------------------------------
 
@@ -162,13 +639,36 @@ namespace rst
         Color b = c01 * (1 - tx) + c11 * tx;
         return a * (1 - ty) + b * ty;
     }
-#define BILINEAR
+
+	// -----------------------------------------------------------------------------------------------------------------------------------
+
 	uint32_t Texture::sample(float x, float y)
 	{
-#if defined(BILINEAR)
-        // Bilinear Filtering
-        float x_coord = x * (float(m_width) - 1.0f);
-        float y_coord = y * (float(m_height) - 1.0f);
+		return sample_bilinear(x, y);
+	}
+
+	// -----------------------------------------------------------------------------------------------------------------------------------
+
+	uint32_t Texture::sample_nearest(float x, float y, uint32_t level)
+	{
+		uint32_t width = std::max(m_width >> level, 1u);
+		uint32_t height = std::max(m_height >> level, 1u);
+
+        uint32_t x_coord = x * (width - 1);
+        uint32_t y_coord = y * (height - 1);
+
+        return m_pixels[sample_offset(x_coord, y_coord, level)].pixel;
+	}
+
+	// -----------------------------------------------------------------------------------------------------------------------------------
+
+	uint32_t Texture::sample_bilinear(float x, float y, uint32_t level)
+	{
+		uint32_t width = std::max(m_width >> level, 1u);
+		uint32_t height = std::max(m_height >> level, 1u);
+
+        float x_coord = x * (float(width) - 1.0f);
+        float y_coord = y * (float(height) - 1.0f);
         
         // Get floor value of coordinate
         uint32_t x_floor = uint32_t(x_coord);
@@ -182,31 +682,78 @@ namespace rst
         float tx = x_coord - x_floor;
         float ty = y_coord - y_floor;
         
-        Color& c00 = m_pixels[y_floor * m_width + x_floor];
-        Color& c01 = m_pixels[y_ceil * m_width + x_floor];
-        Color& c10 = m_pixels[y_floor * m_width + x_ceil];
-        Color& c11 = m_pixels[y_ceil * m_width + x_ceil];
+        const Color& c00 = m_pixels[sample_offset(x_floor, y_floor, level)];
+        const Color& c01 = m_pixels[sample_offset(x_floor, y_ceil, level)];
+        const Color& c10 = m_pixels[sample_offset(x_ceil, y_floor, level)];
+        const Color& c11 = m_pixels[sample_offset(x_ceil, y_ceil, level)];
         
         return bilinear_interpolation(tx, ty, c00, c01, c10, c11).pixel;
-#else
-        uint32_t x_coord = x * (m_width - 1);
-        uint32_t y_coord = y * (m_height - 1);
+	}
 
-        return m_pixels[y_coord * m_width + x_coord].pixel;
-#endif
+	// -----------------------------------------------------------------------------------------------------------------------------------
+
+	uint32_t Texture::sample_mip_nearest(float x, float y, float lod)
+	{
+		return sample_bilinear(x, y, uint32_t(lod + 0.5f));
+	}
+
+	// -----------------------------------------------------------------------------------------------------------------------------------
+
+	uint32_t Texture::sample_trilinear(float x, float y, float lod)
+	{
+		uint32_t level = uint32_t(lod);
+		float t = lod - float(level);
+
+		Color c0 = sample_bilinear(x, y, level);
+
+		if (t == 0.0f || level + 1 >= m_mip_count)
+			return c0.pixel;
+
+		Color c1 = sample_bilinear(x, y, level + 1);
+
+		return (c0 * (1.0f - t) + c1 * t).pixel;
+	}
+
+	// -----------------------------------------------------------------------------------------------------------------------------------
+
+	float Texture::lod(float du_dx, float dv_dx, float du_dy, float dv_dy) const
+	{
+		// Squared length of the larger of the pixel's two footprint axes, in level 0 texels
+		float width = float(m_width);
+		float height = float(m_height);
+
+		float length_x = du_dx * du_dx * width * width + dv_dx * dv_dx * height * height;
+		float length_y = du_dy * du_dy * width * width + dv_dy * dv_dy * height * height;
+
+		float lod = 0.5f * log2f(std::max(length_x, length_y));
+
+		// Also catches the NaN of a zero footprint
+		if (!(lod > 0.0f))
+			return 0.0f;
+
+		return std::min(lod, float(m_mip_count - 1));
 	}
 
 	// -----------------------------------------------------------------------------------------------------------------------------------
 
 	void Texture::clear()
 	{
+		RST_PROFILE_SCOPE("Clear Depth");
+
 		if (m_depth)
 		{
-			uint32_t size = m_width * m_height;
+			uint32_t size = texel_count();
 			float depth = INFINITY;
 
 			for (uint32_t i = 0; i < size; i++)
 				m_depth[i] = depth;
+
+			uint32_t block_count = ((m_width + kBlockSize - 1) / kBlockSize) * ((m_height + kBlockSize - 1) / kBlockSize);
+			uint32_t tile_count = ((m_width + kTileSize - 1) / kTileSize) * ((m_height + kTileSize - 1) / kTileSize);
+
+			std::fill(m_block_min_depth, m_block_min_depth + block_count, depth);
+			std::fill(m_block_max_depth, m_block_max_depth + block_count, depth);
+			std::fill(m_tile_max_depth, m_tile_max_depth + tile_count, depth);
 		}
 	}
 
@@ -214,10 +761,12 @@ namespace rst
 
 	void Texture::clear(float r, float g, float b, float a)
 	{
+		RST_PROFILE_SCOPE("Clear Color");
+
 		if (m_pixels)
 		{
 			Color color = Color(b * 255.0f, g * 255.0f, r * 255.0f, a * 255.0f);
-			uint32_t size = m_width * m_height;
+			uint32_t size = texel_count();
 
 			for (uint32_t i = 0; i < size; i++)
 				m_pixels[i] = color.pixel;
@@ -226,6 +775,102 @@ namespace rst
 
 	// -----------------------------------------------------------------------------------------------------------------------------------
 
+	// Copies the color pixels into a linear, top row first image with 'pitch' bytes between rows.
+	void Texture::resolve(void* pixels, uint32_t pitch)
+	{
+		RST_PROFILE_SCOPE("Resolve");
+
+		if (!m_pixels)
+			return;
+
+		uint8_t* dst = (uint8_t*)pixels;
+
+		if (m_layout == TEXTURE_LAYOUT_LINEAR)
+		{
+			for (uint32_t y = 0; y < m_height; y++)
+				memcpy(dst + y * pitch, &m_pixels[y * m_width], m_width * sizeof(Color));
+
+			return;
+		}
+
+		// Swizzled rows are already top row first, in runs of a block's width
+		if (m_layout == TEXTURE_LAYOUT_SWIZZLED)
+		{
+			for (uint32_t y = 0; y < m_height; y++)
+			{
+				for (uint32_t x = 0; x < m_width; x += kTexelBlockSize)
+					memcpy(dst + y * pitch + x * sizeof(Color), &m_pixels[sample_offset(x, y, 0)], std::min(uint32_t(kTexelBlockSize), m_width - x) * sizeof(Color));
+			}
+
+			return;
+		}
+
+		// Walk the blocks so every read is a contiguous block row
+		int32_t blocks_y = int32_t((m_height + kBlockSize - 1) / kBlockSize);
+
+		#pragma omp parallel for
+		for (int32_t block_y = 0; block_y < blocks_y; block_y++)
+		{
+			uint32_t first_y = block_y * kBlockSize;
+			uint32_t last_y = std::min(first_y + kBlockSize, m_height);
+
+			for (uint32_t block_x = 0; block_x < m_width; block_x += kBlockSize)
+			{
+				uint32_t count = std::min(uint32_t(kBlockSize), m_width - block_x);
+
+				for (uint32_t y = first_y; y < last_y; y++)
+					memcpy(dst + (m_height - y - 1) * pitch + block_x * sizeof(Color), &m_pixels[texel_offset(block_x, y)], count * sizeof(Color));
+			}
+		}
+	}
+
+	// -----------------------------------------------------------------------------------------------------------------------------------
+
+	bool Texture::save(const std::string& file)
+	{
+		if (!m_pixels)
+		{
+			std::cout << "ERROR: Only color textures can be saved!" << std::endl;
+			return false;
+		}
+
+		size_t dot = file.find_last_of('.');
+		std::string extension = dot == std::string::npos ? "" : file.substr(dot + 1);
+
+		std::vector<uint32_t> pixels(m_width * m_height);
+		resolve(pixels.data(), m_width * sizeof(uint32_t));
+
+		// Pixels are stored as BGRA, the image writers expect RGBA
+		for (auto& pixel : pixels)
+			pixel = (pixel & 0xFF00FF00) | ((pixel >> 16) & 0xFF) | ((pixel & 0xFF) << 16);
+
+		int result = 0;
+
+		if (extension == "png")
+			result = stbi_write_png(file.c_str(), m_width, m_height, 4, pixels.data(), m_width * sizeof(uint32_t));
+		else if (extension == "bmp")
+			result = stbi_write_bmp(file.c_str(), m_width, m_height, 4, pixels.data());
+		else if (extension == "tga")
+			result = stbi_write_tga(file.c_str(), m_width, m_height, 4, pixels.data());
+		else if (extension == "jpg" || extension == "jpeg")
+			result = stbi_write_jpg(file.c_str(), m_width, m_height, 4, pixels.data(), 90);
+		else
+		{
+			std::cout << "ERROR: Unsupported image format: " << file << std::endl;
+			return false;
+		}
+
+		if (!result)
+		{
+			std::cout << "ERROR: Failed to write image: " << file << std::endl;
+			return false;
+		}
+
+		return true;
+	}
+
+	// -----------------------------------------------------------------------------------------------------------------------------------
+
 	Material::Material()
 	{
 		diffuse = nullptr;
@@ -345,11 +990,16 @@ namespace rst
 		const aiScene* Scene;
 		Assimp::Importer Importer;
         
-        std::string base_path = SDL_GetBasePath();
-        std::string path = base_path + file;
-        
+		std::string path = g_base_path + file;
+
 		Scene = Importer.ReadFile(path, aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
 
+		if (!Scene)
+		{
+			std::cout << "ERROR: Failed to load model: " << path << ": " << Importer.GetErrorString() << std::endl;
+			return false;
+		}
+
 		uint32_t mesh_count = Scene->mNumMeshes;
 		uint32_t index_count = 0;
 		uint32_t vertex_count = 0;
@@ -497,355 +1147,2104 @@ namespace rst
 
 	// -----------------------------------------------------------------------------------------------------------------------------------
 
-	inline float edge_function(const vec2f &a, const vec2f &b, const vec2f &c)
+	inline int32_t to_fixed_point(float v)
 	{
-		return (b.x - a.x)*(c.y - a.y) - (b.y - a.y)*(c.x - a.x);
+		return int32_t(lrintf(v * float(kSubpixelStep)));
 	}
 
 	// -----------------------------------------------------------------------------------------------------------------------------------
 
-	inline vec2f convert_to_screen_space(const float& x, const float& y, const uint32_t& width, const uint32_t& height)
+	inline void setup_edge(int32_t ax, int32_t ay, int32_t bx, int32_t by, EdgeEquation& edge)
 	{
-		return vec2f(int((((x + 1) * width) * 0.5f) + 0.5f), int((((y + 1) * height) * 0.5f) + 0.5f));
+		edge.a = ay - by;
+		edge.b = bx - ax;
+
+		// Top-left fill rule: pixel centers exactly on an edge belong to the triangle only if the edge is a left edge or a
+		// top edge, so pixels on an edge shared by two triangles are drawn exactly once.
+		bool top_left = edge.a > 0 || (edge.a == 0 && edge.b < 0);
+
+		// Fold the half-pixel center offset and the fill rule bias into the constant, then drop the sub-pixel bits. The
+		// result is exact since the sub-pixel bits of every pixel center's edge value are identical.
+		int64_t c = -(int64_t(edge.a) * ax + int64_t(edge.b) * ay);
+		c += int64_t(kSubpixelStep / 2) * (edge.a + edge.b) + (top_left ? 0 : -1);
+
+		edge.c = c >> kSubpixelBits;
 	}
 
 	// -----------------------------------------------------------------------------------------------------------------------------------
 
-	inline void triangle(const Vertex& v0, const Vertex& v1, const Vertex& v2, const mat4f& vp, Texture* color_tex, Texture* depth_tex)
+	inline void transform_vertex(const Vertex& vertex, const mat4f& model, const mat4f& vp, ClipVertex& out)
 	{
-		uint32_t width = color_tex->m_width;
-		uint32_t height = color_tex->m_height;
-
 		// Convert to world space 
-		vec4f v0world = g_current_model_mat * vec4f(v0.position.x, v0.position.y, v0.position.z, 1.0f);
-		vec4f v1world = g_current_model_mat * vec4f(v1.position.x, v1.position.y, v1.position.z, 1.0f);
-		vec4f v2world = g_current_model_mat * vec4f(v2.position.x, v2.position.y, v2.position.z, 1.0f);
+		vec4f world = model * vec4f(vertex.position.x, vertex.position.y, vertex.position.z, 1.0f);
+
+		// Convert to clip space
+		out.position = vp * world;
+
+		out.varyings[VARYING_WORLD_POSITION + 0] = world.x;
+		out.varyings[VARYING_WORLD_POSITION + 1] = world.y;
+		out.varyings[VARYING_WORLD_POSITION + 2] = world.z;
+		out.varyings[VARYING_NORMAL + 0] = vertex.normal.x;
+		out.varyings[VARYING_NORMAL + 1] = vertex.normal.y;
+		out.varyings[VARYING_NORMAL + 2] = vertex.normal.z;
+		out.varyings[VARYING_TEXCOORD + 0] = vertex.texcoord.x;
+		out.varyings[VARYING_TEXCOORD + 1] = vertex.texcoord.y;
+	}
+
+	// -----------------------------------------------------------------------------------------------------------------------------------
+
+	inline uint32_t compute_outcode(const vec4f& p, float guard_band_x, float guard_band_y)
+	{
+		uint32_t code = 0;
+
+		if (p.x < -p.w) code |= CLIP_LEFT;
+		if (p.x > p.w) code |= CLIP_RIGHT;
+		if (p.y < -p.w) code |= CLIP_BOTTOM;
+		if (p.y > p.w) code |= CLIP_TOP;
+		if (p.z < -p.w) code |= CLIP_NEAR;
+		if (p.z > p.w) code |= CLIP_FAR;
+		if (p.x < -guard_band_x * p.w) code |= CLIP_GUARD_BAND_LEFT;
+		if (p.x > guard_band_x * p.w) code |= CLIP_GUARD_BAND_RIGHT;
+		if (p.y < -guard_band_y * p.w) code |= CLIP_GUARD_BAND_BOTTOM;
+		if (p.y > guard_band_y * p.w) code |= CLIP_GUARD_BAND_TOP;
+
+		return code;
+	}
+
+	// -----------------------------------------------------------------------------------------------------------------------------------
+
+	inline simd::int8 compute_outcode(const simd::vec4fx8& p, float guard_band_x, float guard_band_y)
+	{
+		using namespace simd;
+
+		float8 neg_w = float8() - p.w;
+		float8 guard_x = float8::broadcast(guard_band_x) * p.w;
+		float8 guard_y = float8::broadcast(guard_band_y) * p.w;
+
+		int8 code = int8::as_int(p.x < neg_w) & int8::broadcast(CLIP_LEFT);
+
+		code = code | (int8::as_int(p.x > p.w) & int8::broadcast(CLIP_RIGHT));
+		code = code | (int8::as_int(p.y < neg_w) & int8::broadcast(CLIP_BOTTOM));
+		code = code | (int8::as_int(p.y > p.w) & int8::broadcast(CLIP_TOP));
+		code = code | (int8::as_int(p.z < neg_w) & int8::broadcast(CLIP_NEAR));
+		code = code | (int8::as_int(p.z > p.w) & int8::broadcast(CLIP_FAR));
+		code = code | (int8::as_int(p.x < float8() - guard_x) & int8::broadcast(CLIP_GUARD_BAND_LEFT));
+		code = code | (int8::as_int(p.x > guard_x) & int8::broadcast(CLIP_GUARD_BAND_RIGHT));
+		code = code | (int8::as_int(p.y < float8() - guard_y) & int8::broadcast(CLIP_GUARD_BAND_BOTTOM));
+		code = code | (int8::as_int(p.y > guard_y) & int8::broadcast(CLIP_GUARD_BAND_TOP));
+
+		return code;
+	}
+
+	// -----------------------------------------------------------------------------------------------------------------------------------
+
+	void resize_clip_vertex_buffer(ClipVertexBuffer& buffer, uint32_t count)
+	{
+		if (buffer.outcodes.size() >= count)
+			return;
+
+		for (int i = 0; i < 4; i++)
+			buffer.position[i].resize(count);
+
+		for (int i = 0; i < VARYING_COUNT; i++)
+			buffer.varyings[i].resize(count);
+
+		buffer.outcodes.resize(count);
+	}
+
+	// -----------------------------------------------------------------------------------------------------------------------------------
+
+	inline void store_clip_vertex(ClipVertexBuffer& buffer, uint32_t i, const ClipVertex& v)
+	{
+		buffer.position[0][i] = v.position.x;
+		buffer.position[1][i] = v.position.y;
+		buffer.position[2][i] = v.position.z;
+		buffer.position[3][i] = v.position.w;
+
+		for (int j = 0; j < VARYING_COUNT; j++)
+			buffer.varyings[j][i] = v.varyings[j];
+	}
+
+	// -----------------------------------------------------------------------------------------------------------------------------------
+
+	inline void load_clip_vertex(const ClipVertexBuffer& buffer, uint32_t i, ClipVertex& v)
+	{
+		v.position = vec4f(buffer.position[0][i], buffer.position[1][i], buffer.position[2][i], buffer.position[3][i]);
+
+		for (int j = 0; j < VARYING_COUNT; j++)
+			v.varyings[j] = buffer.varyings[j][i];
+	}
+
+	// -----------------------------------------------------------------------------------------------------------------------------------
+
+	// Transforms the eight consecutive vertices starting at 'vertices'. Attributes are gathered from the interleaved vertex
+	// layout into SoA registers, and the results are written to 'buffer' starting at index 'offset'.
+	inline void transform_vertices(ClipVertexBuffer& buffer, const Vertex* vertices, uint32_t offset, const simd::mat4fx8& model, const simd::mat4fx8& vp, float guard_band_x, float guard_band_y)
+	{
+		using namespace simd;
+
+		const int32_t stride = sizeof(Vertex) / sizeof(float);
+		const int8	  index = int8(0, 1, 2, 3, 4, 5, 6, 7) * int8::broadcast(stride);
+
+		const Vertex& v = *vertices;
+
+		vec4fx8 position(gather(&v.position.x, index), gather(&v.position.y, index), gather(&v.position.z, index), float8::broadcast(1.0f));
+
+		// Convert to world space
+		vec4fx8 world = model * position;
+
+		// Convert to clip space
+		vec4fx8 clip = vp * world;
+
+		clip.x.store_unaligned(&buffer.position[0][offset]);
+		clip.y.store_unaligned(&buffer.position[1][offset]);
+		clip.z.store_unaligned(&buffer.position[2][offset]);
+		clip.w.store_unaligned(&buffer.position[3][offset]);
+
+		world.x.store_unaligned(&buffer.varyings[VARYING_WORLD_POSITION + 0][offset]);
+		world.y.store_unaligned(&buffer.varyings[VARYING_WORLD_POSITION + 1][offset]);
+		world.z.store_unaligned(&buffer.varyings[VARYING_WORLD_POSITION + 2][offset]);
+
+		gather(&v.normal.x, index).store_unaligned(&buffer.varyings[VARYING_NORMAL + 0][offset]);
+		gather(&v.normal.y, index).store_unaligned(&buffer.varyings[VARYING_NORMAL + 1][offset]);
+		gather(&v.normal.z, index).store_unaligned(&buffer.varyings[VARYING_NORMAL + 2][offset]);
+
+		gather(&v.texcoord.x, index).store_unaligned(&buffer.varyings[VARYING_TEXCOORD + 0][offset]);
+		gather(&v.texcoord.y, index).store_unaligned(&buffer.varyings[VARYING_TEXCOORD + 1][offset]);
+
+		compute_outcode(clip, guard_band_x, guard_band_y).store_unaligned((int32_t*)&buffer.outcodes[offset]);
+	}
+
+	// -----------------------------------------------------------------------------------------------------------------------------------
+
+	// Clips a convex polygon in place against the plane dot(plane, position) >= 0.
+	inline void clip_polygon(ClipVertex* polygon, uint32_t& count, const vec4f& plane, uint32_t varying_count)
+	{
+		ClipVertex in[kMaxClipVertices];
+		std::copy(polygon, polygon + count, in);
+
+		ClipVertex* out = polygon;
+		uint32_t out_count = 0;
+
+		for (uint32_t i = 0; i < count; i++)
+		{
+			const ClipVertex* a = &in[i];
+			const ClipVertex* b = &in[(i + 1) % count];
 
-		// Convert to screen space
-		vec4f v0ndc = vp * v0world;
-		vec4f v1ndc = vp * v1world;
-		vec4f v2ndc = vp * v2world;
+			float da = plane.dot(a->position);
+			float db = plane.dot(b->position);
 
+			if (da >= 0.0f)
+				out[out_count++] = *a;
+
+			if ((da >= 0.0f) != (db >= 0.0f))
+			{
+				// Always interpolate from the inside vertex so that an edge shared by two triangles is split at exactly the same point
+				if (da < 0.0f)
+				{
+					std::swap(a, b);
+					std::swap(da, db);
+				}
+
+				float t = da / (da - db);
+				ClipVertex& v = out[out_count++];
+
+				v.position = a->position + (b->position - a->position) * t;
+
+				for (uint32_t j = 0; j < varying_count; j++)
+					v.varyings[j] = a->varyings[j] + (b->varyings[j] - a->varyings[j]) * t;
+			}
+		}
+
+		count = out_count;
+	}
+
+	// -----------------------------------------------------------------------------------------------------------------------------------
+
+	// Outcome of triangle setup.
+	enum SetupResult
+	{
+		SETUP_ACCEPTED = 0,
+		SETUP_OFF_SCREEN,
+		SETUP_ZERO_AREA,
+		SETUP_FACE_CULLED
+	};
+
+	// -----------------------------------------------------------------------------------------------------------------------------------
+
+	inline SetupResult setup_triangle(const ClipVertex& v0, const ClipVertex& v1, const ClipVertex& v2, uint32_t varying_count, uint32_t width, uint32_t height, CullMode cull_mode, FrontFace front_face, TriangleSetup& tri)
+	{
 		// Keep view space Z around for perspective correct interpolation
-        float v0view_z = v0ndc.w;
-        float v1view_z = v1ndc.w;
-        float v2view_z = v2ndc.w;
+        float v0view_z = v0.position.w;
+        float v1view_z = v1.position.w;
+        float v2view_z = v2.position.w;
         
         // Perspective division
-		v0ndc = v0ndc / v0ndc.w;
-		v1ndc = v1ndc / v1ndc.w;
-		v2ndc = v2ndc / v2ndc.w;
+		vec4f v0ndc = v0.position / v0view_z;
+		vec4f v1ndc = v1.position / v1view_z;
+		vec4f v2ndc = v2.position / v2view_z;
 
 		// Screen coords
-		vec2f v0screen = convert_to_screen_space(v0ndc.x, v0ndc.y, width, height);
-		vec2f v1screen = convert_to_screen_space(v1ndc.x, v1ndc.y, width, height);
-		vec2f v2screen = convert_to_screen_space(v2ndc.x, v2ndc.y, width, height);
+		vec2f screen[3] = 
+		{
+			vec2f((v0ndc.x + 1.0f) * width * 0.5f, (v0ndc.y + 1.0f) * height * 0.5f),
+			vec2f((v1ndc.x + 1.0f) * width * 0.5f, (v1ndc.y + 1.0f) * height * 0.5f),
+			vec2f((v2ndc.x + 1.0f) * width * 0.5f, (v2ndc.y + 1.0f) * height * 0.5f)
+		};
+
+		// Reject anything the clipper let through that can't be represented in fixed point
+		for (int i = 0; i < 3; i++)
+		{
+			if (!(fabsf(screen[i].x) < kMaxScreenCoord && fabsf(screen[i].y) < kMaxScreenCoord))
+				return SETUP_OFF_SCREEN;
+		}
+
+		// Snap to the sub-pixel grid
+		int32_t x[3];
+		int32_t y[3];
+
+		for (int i = 0; i < 3; i++)
+		{
+			x[i] = to_fixed_point(screen[i].x);
+			y[i] = to_fixed_point(screen[i].y);
+		}
 
-		// Find triangle bounding box
-		vec2f bboxmin(std::numeric_limits<float>::max(), std::numeric_limits<float>::max());
-		vec2f bboxmax(-std::numeric_limits<float>::max(), -std::numeric_limits<float>::max());
+		// Triangle area, with counter-clockwise triangles having a positive area
+		int64_t area = int64_t(x[1] - x[0]) * (y[2] - y[0]) - int64_t(y[1] - y[0]) * (x[2] - x[0]);
 
-		vec2f clamp(width - 1, height - 1);
+		// Zero-area triangles never cover a pixel
+		if (area == 0)
+			return SETUP_ZERO_AREA;
 
-		// Min
-		bboxmin.x = std::max(0.0f, std::min(bboxmin.x, v0screen.x));
-		bboxmin.x = std::max(0.0f, std::min(bboxmin.x, v1screen.x));
-		bboxmin.x = std::max(0.0f, std::min(bboxmin.x, v2screen.x));
+		// Face culling
+		bool front_facing = (area > 0) == (front_face == FRONT_FACE_CCW);
 
-		bboxmin.y = std::max(0.0f, std::min(bboxmin.y, v0screen.y));
-		bboxmin.y = std::max(0.0f, std::min(bboxmin.y, v1screen.y));
-		bboxmin.y = std::max(0.0f, std::min(bboxmin.y, v2screen.y));
+		if ((cull_mode == CULL_MODE_BACK && !front_facing) || (cull_mode == CULL_MODE_FRONT && front_facing))
+			return SETUP_FACE_CULLED;
 
-		// Max
-		bboxmax.x = std::min(clamp.x, std::max(bboxmax.x, v0screen.x));
-		bboxmax.x = std::min(clamp.x, std::max(bboxmax.x, v1screen.x));
-		bboxmax.x = std::min(clamp.x, std::max(bboxmax.x, v2screen.x));
+		// The rasterizer expects a positive area, so flip the winding of clockwise triangles that weren't culled
+		if (area < 0)
+			return setup_triangle(v0, v2, v1, varying_count, width, height, CULL_MODE_NONE, front_face, tri);
 
-		bboxmax.y = std::min(clamp.y, std::max(bboxmax.y, v0screen.y));
-		bboxmax.y = std::min(clamp.y, std::max(bboxmax.y, v1screen.y));
-		bboxmax.y = std::min(clamp.y, std::max(bboxmax.y, v2screen.y));
+		// Find triangle bounding box, clamped to the render target
+		tri.min_x = std::max(std::min(x[0], std::min(x[1], x[2])) >> kSubpixelBits, 0);
+		tri.min_y = std::max(std::min(y[0], std::min(y[1], y[2])) >> kSubpixelBits, 0);
+		tri.max_x = std::min(std::max(x[0], std::max(x[1], x[2])) >> kSubpixelBits, int32_t(width) - 1);
+		tri.max_y = std::min(std::max(y[0], std::max(y[1], y[2])) >> kSubpixelBits, int32_t(height) - 1);
 
-        // Divide vertex attributes by view space Z for perspective correct interpolation
-        vec2f v0tc = v0.texcoord / v0view_z;
-        vec2f v1tc = v1.texcoord / v1view_z;
-        vec2f v2tc = v2.texcoord / v2view_z;
-        
-        vec3f v0n = v0.normal / v0view_z;
-        vec3f v1n = v1.normal / v1view_z;
-        vec3f v2n = v2.normal / v2view_z;
+		// Entirely off-screen, nothing to bin
+		if (tri.min_x > tri.max_x || tri.min_y > tri.max_y)
+			return SETUP_OFF_SCREEN;
 
-		vec3f v0w = vec3f(v0world.x, v0world.y, v0world.z) / v0view_z;
-		vec3f v1w = vec3f(v1world.x, v1world.y, v1world.z) / v1view_z;
-		vec3f v2w = vec3f(v2world.x, v2world.y, v2world.z) / v2view_z;
+		// Edge equations, edge i being the one opposite vertex i
+		setup_edge(x[1], y[1], x[2], y[2], tri.edges[0]);
+		setup_edge(x[2], y[2], x[0], y[0], tri.edges[1]);
+		setup_edge(x[0], y[0], x[1], y[1], tri.edges[2]);
+
+		// Barycentric coordinates of vertex 1 and 2 as planes over pixel coordinates
+		double inv_area = 1.0 / double(area);
+
+		for (int i = 0; i < 2; i++)
+		{
+			const EdgeEquation& edge = tri.edges[i + 1];
+			int64_t c = -(int64_t(edge.a) * x[(i + 2) % 3] + int64_t(edge.b) * y[(i + 2) % 3]) + int64_t(kSubpixelStep / 2) * (edge.a + edge.b);
+
+			tri.bary_dx[i] = float(double(edge.a) * kSubpixelStep * inv_area);
+			tri.bary_dy[i] = float(double(edge.b) * kSubpixelStep * inv_area);
+			tri.bary_c[i] = float(double(c) * inv_area);
+		}
+
+        // Divide vertex attributes by view space Z for perspective correct interpolation
+		for (uint32_t i = 0; i < varying_count; i++)
+		{
+			tri.varyings[0][i] = v0.varyings[i] / v0view_z;
+			tri.varyings[1][i] = v1.varyings[i] / v1view_z;
+			tri.varyings[2][i] = v2.varyings[i] / v2view_z;
+		}
         
         // One over view Z
-        v0view_z = 1.0f / v0view_z;
-        v1view_z = 1.0f / v1view_z;
-        v2view_z = 1.0f / v2view_z;
-        
-        // Triangle area
-        float area = edge_function(v0screen, v1screen, v2screen);
-        
-        vec2f p;
+        tri.inv_view_z[0] = 1.0f / v0view_z;
+        tri.inv_view_z[1] = 1.0f / v1view_z;
+        tri.inv_view_z[2] = 1.0f / v2view_z;
+
+		// Depth range covered by the triangle, for hierarchical Z tests
+		tri.min_z = std::min(v0view_z, std::min(v1view_z, v2view_z));
+		tri.max_z = std::max(v0view_z, std::max(v1view_z, v2view_z));
+
+		return SETUP_ACCEPTED;
+	}
+
+	// -----------------------------------------------------------------------------------------------------------------------------------
 
-		// Iterate over pixels in triangle bounding box
-		for (p.x = bboxmin.x; p.x <= bboxmax.x; p.x++)
+	// Shades the covered pixels of a span of 8 horizontally adjacent pixels starting at (x, y). The depth test can be skipped
+	// when the triangle is known to be in front of everything in the span. Returns the mask of the pixels written.
+	template<typename Pipeline>
+	inline int shade_span(const BuiltinShader& shader, const TriangleSetup& tri, const Tile& tile, int32_t x, int32_t y, simd::float8 mask, bool depth_test, Texture* color_tex, Texture* depth_tex)
+	{
+		using namespace simd;
+
+		const float8 one = float8::broadcast(1.0f);
+		const float8 zero = float8::broadcast(0.0f);
+
+		float8 w0, w1, w2;
+
+		if (!depth_test_span<Pipeline::kDepthWrite>(tri, x, y, mask, depth_test, depth_tex, w0, w1, w2))
+			return 0;
+
+		// Interpolate the attributes the pipeline uses
+		float8 nx, ny, nz;
+
+		if (Pipeline::kLit)
+		{
+			nx = float8::broadcast(tri.varyings[0][VARYING_NORMAL + 0]) * w0 + float8::broadcast(tri.varyings[1][VARYING_NORMAL + 0]) * w1 + float8::broadcast(tri.varyings[2][VARYING_NORMAL + 0]) * w2;
+			ny = float8::broadcast(tri.varyings[0][VARYING_NORMAL + 1]) * w0 + float8::broadcast(tri.varyings[1][VARYING_NORMAL + 1]) * w1 + float8::broadcast(tri.varyings[2][VARYING_NORMAL + 1]) * w2;
+			nz = float8::broadcast(tri.varyings[0][VARYING_NORMAL + 2]) * w0 + float8::broadcast(tri.varyings[1][VARYING_NORMAL + 2]) * w1 + float8::broadcast(tri.varyings[2][VARYING_NORMAL + 2]) * w2;
+
+			float8 inv_length = one / sqrt(nx * nx + ny * ny + nz * nz);
+			nx = nx * inv_length;
+			ny = ny * inv_length;
+			nz = nz * inv_length;
+		}
+
+		float8 wx, wy, wz;
+
+		if (Pipeline::kPointLights)
+		{
+			wx = float8::broadcast(tri.varyings[0][VARYING_WORLD_POSITION + 0]) * w0 + float8::broadcast(tri.varyings[1][VARYING_WORLD_POSITION + 0]) * w1 + float8::broadcast(tri.varyings[2][VARYING_WORLD_POSITION + 0]) * w2;
+			wy = float8::broadcast(tri.varyings[0][VARYING_WORLD_POSITION + 1]) * w0 + float8::broadcast(tri.varyings[1][VARYING_WORLD_POSITION + 1]) * w1 + float8::broadcast(tri.varyings[2][VARYING_WORLD_POSITION + 1]) * w2;
+			wz = float8::broadcast(tri.varyings[0][VARYING_WORLD_POSITION + 2]) * w0 + float8::broadcast(tri.varyings[1][VARYING_WORLD_POSITION + 2]) * w1 + float8::broadcast(tri.varyings[2][VARYING_WORLD_POSITION + 2]) * w2;
+		}
+
+		// @TODO: Transform normal into world space.
+
+		// Fetch texture samples
+		float8 diffuse_r = float8::broadcast(255.0f);
+		float8 diffuse_g = float8::broadcast(255.0f);
+		float8 diffuse_b = float8::broadcast(255.0f);
+
+		if (Pipeline::kTextured)
 		{
-			for (p.y = bboxmin.y; p.y <= bboxmax.y; p.y++)
+			Texture* diffuse_texture = shader.textures[TEXTURE_DIFFUSE];
+
+			float8 u = float8::broadcast(tri.varyings[0][VARYING_TEXCOORD + 0]) * w0 + float8::broadcast(tri.varyings[1][VARYING_TEXCOORD + 0]) * w1 + float8::broadcast(tri.varyings[2][VARYING_TEXCOORD + 0]) * w2;
+			float8 v = float8::broadcast(tri.varyings[0][VARYING_TEXCOORD + 1]) * w0 + float8::broadcast(tri.varyings[1][VARYING_TEXCOORD + 1]) * w1 + float8::broadcast(tri.varyings[2][VARYING_TEXCOORD + 1]) * w2;
+
+			int8 texel;
+
+			if (Pipeline::kFilter == FILTER_MODE_NEAREST)
+				texel = sample_nearest_span(diffuse_texture, u, v);
+			else if (Pipeline::kFilter == FILTER_MODE_BILINEAR)
+				texel = sample_bilinear_span(diffuse_texture, u, v, int8::broadcast(0));
+			else
 			{
-				// Calculate barycentric coordinates
-				float w0 = edge_function(v1screen, v2screen, p);
-				float w1 = edge_function(v2screen, v0screen, p);
-				float w2 = edge_function(v0screen, v1screen, p);
+				// Screen space derivatives of the texture coordinates, from the derivatives of their numerator and of the
+				// interpolated one over view Z. With u = A / W: du/dx = (dA/dx - u * dW/dx) / W, and 1 / W is the pixel's view Z.
+				float db_dx[3] = { -(tri.bary_dx[0] + tri.bary_dx[1]), tri.bary_dx[0], tri.bary_dx[1] };
+				float db_dy[3] = { -(tri.bary_dy[0] + tri.bary_dy[1]), tri.bary_dy[0], tri.bary_dy[1] };
 
-				// Is the current pixel within the triangle?
-				if (w0 >= 0 && w1 >= 0 && w2 >= 0)
+				float da_dx[2] = { 0.0f, 0.0f };
+				float da_dy[2] = { 0.0f, 0.0f };
+				float dw_dx = 0.0f;
+				float dw_dy = 0.0f;
+
+				for (int i = 0; i < 3; i++)
 				{
-					w0 /= area;
-					w1 /= area;
-					w2 /= area;
+					for (int c = 0; c < 2; c++)
+					{
+						da_dx[c] += tri.varyings[i][VARYING_TEXCOORD + c] * db_dx[i];
+						da_dy[c] += tri.varyings[i][VARYING_TEXCOORD + c] * db_dy[i];
+					}
 
-					// Calculate interpolated pixel depth
-					float z = 1.0f / (v0view_z * w0 + v1view_z * w1 + v2view_z * w2);
+					dw_dx += tri.inv_view_z[i] * db_dx[i];
+					dw_dy += tri.inv_view_z[i] * db_dy[i];
+				}
 
-					// Perform depth test
-					if (z < depth_tex->m_depth[int(p.x + p.y * depth_tex->m_width)])
-					{
-						// Update depth buffer value if depth test is passesd
-						depth_tex->m_depth[int(p.x + p.y * depth_tex->m_width)] = z;
+				float8 z = w0 + w1 + w2;
 
-						// Interpolate attributes
-						vec2f texcoord = v0tc * w0 + v1tc * w1 + v2tc * w2;
-                        texcoord = texcoord * z;
-                        
-                        vec3f normal = v0n * w0 + v1n * w1 + v2n * w2; 
-                        normal = (normal * z).normalize();
+				float8 du_dx = (float8::broadcast(da_dx[0]) - u * float8::broadcast(dw_dx)) * z;
+				float8 dv_dx = (float8::broadcast(da_dx[1]) - v * float8::broadcast(dw_dx)) * z;
+				float8 du_dy = (float8::broadcast(da_dy[0]) - u * float8::broadcast(dw_dy)) * z;
+				float8 dv_dy = (float8::broadcast(da_dy[1]) - v * float8::broadcast(dw_dy)) * z;
 
-						vec3f world_position = v0w * w0 + v1w * w1 + v2w * w2;
-						world_position = world_position * z;
+				float8 lod = lod_span(diffuse_texture, du_dx, dv_dx, du_dy, dv_dy);
 
-						// @TODO: Transform normal into world space.
-                        
-						// Fetch texture sample
-						Texture* diffuse_texture = g_current_textures[TEXTURE_DIFFUSE];
+				if (Pipeline::kFilter == FILTER_MODE_MIP_NEAREST)
+					texel = sample_bilinear_span(diffuse_texture, u, v, int8::convert(lod + float8::broadcast(0.5f)));
+				else
+				{
+					// Blend the two levels around the level of detail by its fraction
+					int8 level = int8::convert(lod);
+					int8 next_level = min(level + int8::broadcast(1), int8::broadcast(diffuse_texture->m_mip_count - 1));
+					int8 fraction = int8::convert((lod - level.to_float()) * float8::broadcast(256.0f));
 
-						Color diffuse = diffuse_texture ? diffuse_texture->sample(texcoord.x, texcoord.y) : RST_COLOR_RGBA(1.0f, 1.0f, 1.0f, 1.0f);
-						Color ambient = diffuse * 0.3f;
+					texel = lerp_texels(sample_bilinear_span(diffuse_texture, u, v, level), sample_bilinear_span(diffuse_texture, u, v, next_level), fraction);
+				}
+			}
 
-						Color result = Color(0.0f, 0.0f, 0.0f, 1.0f);
+			int8 channel_mask = int8::broadcast(0xFF);
+			diffuse_r = (texel & channel_mask).to_float();
+			diffuse_g = ((texel >> 8) & channel_mask).to_float();
+			diffuse_b = ((texel >> 16) & channel_mask).to_float();
+		}
 
-						// Accumulate directional light contribution
-						for (uint32_t i = 0; i < g_dir_light_count; i++)
-						{
-							float lambert = std::max(0.0f, normal.dot(g_current_dir_lights[i].direction * -1.0f));
-							result = result + diffuse * lambert + ambient;
-						}
+		// Sum of the light intensities; the ambient term is added once per light
+		float8 intensity = zero;
 
-						// Accumulate directional light contribution
-						for (uint32_t i = 0; i < g_point_light_count; i++)
-						{
-							PointLight& light = g_current_point_lights[i];
+		// Accumulate directional light contribution
+		uint32_t dir_light_count = Pipeline::kDirLights == kDynamicLightCount ? shader.dir_light_count : Pipeline::kDirLights;
 
-							float distance = world_position.distance(light.position);
-							float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));
+		for (uint32_t i = 0; i < dir_light_count; i++)
+		{
+			float8 lx = float8::broadcast(shader.dir_lights.direction[0][i]);
+			float8 ly = float8::broadcast(shader.dir_lights.direction[1][i]);
+			float8 lz = float8::broadcast(shader.dir_lights.direction[2][i]);
 
-							vec3f direction = world_position.direction(light.position);
+			float8 lambert = max(zero, nx * lx + ny * ly + nz * lz);
+			intensity = intensity + lambert;
+		}
 
-							float lambert = std::max(0.0f, normal.dot(direction));
-							result = result + diffuse * lambert * attenuation + ambient;
-						}
-		
-						// Write new pixel color
-						color_tex->set_color(result.pixel, p.x, p.y);
-					}
-				}
+		// Accumulate point light contribution, from the lights that can reach this tile
+		if (Pipeline::kPointLights)
+		{
+			for (uint32_t i : *tile.point_lights)
+			{
+				float8 dx = float8::broadcast(shader.point_lights.position[0][i]) - wx;
+				float8 dy = float8::broadcast(shader.point_lights.position[1][i]) - wy;
+				float8 dz = float8::broadcast(shader.point_lights.position[2][i]) - wz;
+
+				float8 constant = float8::broadcast(shader.point_lights.constant[i]);
+				float8 linear = float8::broadcast(shader.point_lights.linear[i]);
+				float8 quadratic = float8::broadcast(shader.point_lights.quadratic[i]);
+
+				float8 distance = sqrt(dx * dx + dy * dy + dz * dz);
+				float8 attenuation = one / (constant + linear * distance + quadratic * (distance * distance));
+
+				float8 lambert = max(zero, (nx * dx + ny * dy + nz * dz) / distance);
+				intensity = intensity + lambert * attenuation;
 			}
 		}
+
+		float8 ambient = float8::broadcast(0.3f * (shader.dir_light_count + shader.point_light_count));
+		intensity = intensity + ambient;
+
+		if (tile.statistics)
+		{
+			uint64_t shaded = _mm_popcnt_u32(mask.movemask());
+			uint64_t lights = dir_light_count + (Pipeline::kPointLights ? tile.point_lights->size() : 0);
+
+			if (Pipeline::kTextured)
+				tile.statistics->texture_samples += shaded;
+
+			tile.statistics->light_evaluations += shaded * lights;
+		}
+
+		// Scale, clamp and pack the channels once, at the end
+		float8 max_channel = float8::broadcast(255.0f);
+
+		int8 r = int8::convert(min(diffuse_r * intensity, max_channel));
+		int8 g = int8::convert(min(diffuse_g * intensity, max_channel));
+		int8 b = int8::convert(min(diffuse_b * intensity, max_channel));
+
+		int8 result = r | (g << 8) | (b << 16) | int8::broadcast(int32_t(0xFF000000));
+
+		// Write new pixel colors
+		int32_t* pixels = (int32_t*)&color_tex->m_pixels[color_tex->texel_offset(x, y)];
+		result.store_masked(pixels, int8::as_int(mask));
+
+		return mask.movemask();
 	}
 
 	// -----------------------------------------------------------------------------------------------------------------------------------
 
-	void initialize()
+	template<typename Pipeline>
+	void rasterize_triangle(const TriangleSetup& tri, const Tile& tile, Texture* color_tex, Texture* depth_tex, const void* shader)
 	{
-		for (int i = 0; i < 3; i++)
-			g_current_textures[i] = nullptr;
+		const BuiltinShader& builtin = *static_cast<const BuiltinShader*>(shader);
+
+		traverse_triangle<Pipeline::kDepthWrite>(tri, tile, depth_tex, [&](int32_t x, int32_t y, simd::float8 mask, bool depth_test)
+		{
+			return shade_span<Pipeline>(builtin, tri, tile, x, y, mask, depth_test, color_tex, depth_tex);
+		});
 	}
 
 	// -----------------------------------------------------------------------------------------------------------------------------------
 
-	void set_vertex_buffer(VertexBuffer* vb)
+	// Kernel selection, resolving one template parameter at a time.
+	template<bool Textured, int32_t DirLights, bool PointLights, FilterMode Filter>
+	RasterizeFunction select_depth_write(bool depth_write)
 	{
-		g_current_vb = vb;
+		if (depth_write)
+			return rasterize_triangle<PipelineState<Textured, DirLights, PointLights, Filter, true>>;
+		else
+			return rasterize_triangle<PipelineState<Textured, DirLights, PointLights, Filter, false>>;
 	}
 
 	// -----------------------------------------------------------------------------------------------------------------------------------
 
-	void set_index_buffer(IndexBuffer* ib)
+	template<bool Textured, int32_t DirLights, bool PointLights>
+	RasterizeFunction select_filter_mode(FilterMode filter, bool depth_write)
 	{
-		g_current_ib = ib;
+		// Untextured pipelines never sample, so they share a single filter mode
+		if (!Textured)
+			return select_depth_write<Textured, DirLights, PointLights, FILTER_MODE_NEAREST>(depth_write);
+
+		switch (filter)
+		{
+		case FILTER_MODE_BILINEAR:
+			return select_depth_write<Textured, DirLights, PointLights, FILTER_MODE_BILINEAR>(depth_write);
+		case FILTER_MODE_MIP_NEAREST:
+			return select_depth_write<Textured, DirLights, PointLights, FILTER_MODE_MIP_NEAREST>(depth_write);
+		case FILTER_MODE_TRILINEAR:
+			return select_depth_write<Textured, DirLights, PointLights, FILTER_MODE_TRILINEAR>(depth_write);
+		default:
+			return select_depth_write<Textured, DirLights, PointLights, FILTER_MODE_NEAREST>(depth_write);
+		}
 	}
 
 	// -----------------------------------------------------------------------------------------------------------------------------------
 
-	void set_directional_lights(uint32_t count, DirectionalLight* lights)
+	template<bool Textured, int32_t DirLights>
+	RasterizeFunction select_point_lights(bool point_lights, FilterMode filter, bool depth_write)
 	{
-		if (lights)
-		{
-			g_dir_light_count = count;
-			g_current_dir_lights = lights;
-		}		
+		if (point_lights)
+			return select_filter_mode<Textured, DirLights, true>(filter, depth_write);
 		else
-		{
-			g_dir_light_count = 0;
-			g_current_dir_lights = nullptr;
-		}
+			return select_filter_mode<Textured, DirLights, false>(filter, depth_write);
 	}
 
 	// -----------------------------------------------------------------------------------------------------------------------------------
 
-	void set_point_lights(uint32_t count, PointLight* lights)
+	template<bool Textured>
+	RasterizeFunction select_dir_lights(uint32_t dir_lights, bool point_lights, FilterMode filter, bool depth_write)
 	{
-		if (lights)
-		{
-			g_point_light_count = count;
-			g_current_point_lights = lights;
-		}
-		else
+		// Common light counts get an unrolled loop, anything above loops over the bound lights
+		switch (dir_lights)
 		{
-			g_point_light_count = 0;
-			g_current_point_lights = nullptr;
+		case 0:
+			return select_point_lights<Textured, 0>(point_lights, filter, depth_write);
+		case 1:
+			return select_point_lights<Textured, 1>(point_lights, filter, depth_write);
+		case 2:
+			return select_point_lights<Textured, 2>(point_lights, filter, depth_write);
+		default:
+			return select_point_lights<Textured, kDynamicLightCount>(point_lights, filter, depth_write);
 		}
 	}
 
 	// -----------------------------------------------------------------------------------------------------------------------------------
 
-	void set_render_target(Texture* color, Texture* depth)
+	void update_pipeline(ContextState& state)
 	{
-		g_current_color_target = color;
-		g_current_depth_target = depth;
+		const BuiltinShader& builtin = state.builtin;
+
+		bool textured = builtin.textures[TEXTURE_DIFFUSE] != nullptr;
+		bool point_lights = builtin.point_light_count > 0;
+
+		if (textured)
+			state.rasterize = select_dir_lights<true>(builtin.dir_light_count, point_lights, state.filter_mode, state.depth_write);
+		else
+			state.rasterize = select_dir_lights<false>(builtin.dir_light_count, point_lights, state.filter_mode, state.depth_write);
+
+		state.pipeline_dirty = false;
 	}
 
 	// -----------------------------------------------------------------------------------------------------------------------------------
 
-	void set_model_matrix(const mat4f& model)
+	inline bool overlaps_tile(const TriangleSetup& tri, int32_t x, int32_t y)
 	{
-		g_current_model_mat = model;
+		// Test the tile corner most inside each edge; if it is outside any edge, the whole tile is
+		for (int i = 0; i < 3; i++)
+		{
+			const EdgeEquation& edge = tri.edges[i];
+
+			int64_t corner_x = edge.a > 0 ? x + kTileSize - 1 : x;
+			int64_t corner_y = edge.b > 0 ? y + kTileSize - 1 : y;
+
+			if (edge.a * corner_x + edge.b * corner_y + edge.c < 0)
+				return false;
+		}
+
+		return true;
 	}
 
 	// -----------------------------------------------------------------------------------------------------------------------------------
 
-	void set_view_matrix(const mat4f& view)
+	inline void bin_triangle(Bin& bin, const TriangleSetup& tri, uint32_t draw, int32_t tiles_x)
 	{
-		g_current_view_mat = view;
+		uint32_t index = bin.triangles.size();
+		bin.triangles.push_back(tri);
+		bin.draws.push_back(draw);
+
+		for (int32_t y = tri.min_y / kTileSize; y <= tri.max_y / kTileSize; y++)
+		{
+			for (int32_t x = tri.min_x / kTileSize; x <= tri.max_x / kTileSize; x++)
+			{
+				if (overlaps_tile(tri, x * kTileSize, y * kTileSize))
+					bin.tiles[y * tiles_x + x].push_back(index);
+			}
+		}
 	}
 
 	// -----------------------------------------------------------------------------------------------------------------------------------
 
-	void set_projection_matrix(const mat4f& projection)
+	inline int32_t thread_count(const ContextState& state)
 	{
-		g_current_projection_mat = projection;
+#ifdef _OPENMP
+		return state.thread_count > 0 ? int32_t(state.thread_count) : omp_get_max_threads();
+#else
+		return 1;
+#endif
 	}
 
 	// -----------------------------------------------------------------------------------------------------------------------------------
 
-	void set_texture(const uint32_t& type, Texture* texture)
+	// Index of the calling thread within a parallel loop.
+	inline int32_t thread_index()
 	{
-		if (type > TEXTURE_SPECULAR)
-		{
-			std::cout << "ERROR: Invalid texture type!" << std::endl;
-			return;
-		}
-
-		g_current_textures[type] = texture;
+#ifdef _OPENMP
+		return omp_get_thread_num();
+#else
+		return 0;
+#endif
 	}
 
 	// -----------------------------------------------------------------------------------------------------------------------------------
 
-	void draw(uint32_t first_index, uint32_t count)
+	// Distance at which a point light's attenuation falls to kLightCutoff, or INFINITY if it never does.
+	inline float light_radius(const PointLight& light)
 	{
-		if (!g_current_vb)
-		{
-			std::cout << "DRAW ERROR: No vertex buffer bound!" << std::endl;
-			return;
-		}
+		// Solve constant + linear * d + quadratic * d^2 = 1 / kLightCutoff for d
+		float c = light.constant - 1.0f / kLightCutoff;
 
-		// Retrieve vertices vector from vertex buffer.
-		std::vector<Vertex>& vertices = g_current_vb->vertices;
+		if (c >= 0.0f)
+			return 0.0f;
 
-		// Compute MVP matrix.
-		mat4f vp = g_current_projection_mat * g_current_view_mat;
-		
-		// Iterate over vertices.
-		#pragma omp parallel for
-		for (int i = 0; i < count; i += 3)
-		{
-			// Rasterize triangle.
-			triangle(vertices[first_index + i], vertices[first_index + i + 1], vertices[first_index + i + 2], vp, g_current_color_target, g_current_depth_target);
-		}
+		if (light.quadratic > 0.0f)
+			return (-light.linear + sqrtf(light.linear * light.linear - 4.0f * light.quadratic * c)) / (2.0f * light.quadratic);
+
+		if (light.linear > 0.0f)
+			return -c / light.linear;
+
+		return INFINITY;
 	}
 
 	// -----------------------------------------------------------------------------------------------------------------------------------
 
-	void draw_indexed(uint32_t count)
+	// Builds the list of point lights that can reach each screen tile. A light is added to every tile overlapped by the
+	// screen-space bounds of the box around its sphere of influence.
+	void cull_point_lights(DrawState& draw_state, uint32_t width, uint32_t height, int32_t tiles_x, int32_t tiles_y)
 	{
-		if (!g_current_vb)
-		{
-			std::cout << "DRAW INDEXED ERROR: No vertex buffer bound!" << std::endl;
-			return;
-		}
+		const PointLightBuffer& point_lights = draw_state.builtin.point_lights;
+		const mat4f& view = draw_state.view_mat;
+		const mat4f& projection = draw_state.projection_mat;
 
-		if (!g_current_ib)
+		draw_state.tile_lights.resize(tiles_x * tiles_y);
+
+		for (auto& lights : draw_state.tile_lights)
+			lights.clear();
+
+		for (uint32_t i = 0; i < draw_state.builtin.point_light_count; i++)
 		{
-			std::cout << "DRAW INDEXED ERROR: No index buffer bound!" << std::endl;
-			return;
-		}
+			float radius = point_lights.radius[i];
 
-		// Retrieve vertices and indices vectors from vertex and index buffers.
-		std::vector<uint32_t>& indices = g_current_ib->indices;
-		std::vector<Vertex>& vertices = g_current_vb->vertices;
+			if (radius <= 0.0f)
+				continue;
 
-		// Compute MVP matrix.
-		mat4f vp = g_current_projection_mat * g_current_view_mat;
+			int32_t min_tile_x = 0;
+			int32_t min_tile_y = 0;
+			int32_t max_tile_x = tiles_x - 1;
+			int32_t max_tile_y = tiles_y - 1;
 
-		// Iterate over vertices,
-		#pragma omp parallel for
-		for (int i = 0; i < count; i += 3)
-		{
-			// Rasterize triangle.
-			triangle(vertices[indices[i]], vertices[indices[i + 1]], vertices[indices[i + 2]], vp, g_current_color_target, g_current_depth_target);
-		}
-	}
+			if (radius < INFINITY)
+			{
+				vec4f center = view * vec4f(point_lights.position[0][i], point_lights.position[1][i], point_lights.position[2][i], 1.0f);
 
-	// -----------------------------------------------------------------------------------------------------------------------------------
+				uint32_t outcode = CLIP_LEFT | CLIP_RIGHT | CLIP_BOTTOM | CLIP_TOP | CLIP_NEAR | CLIP_FAR;
+				bool behind_eye = false;
 
-	void draw_indexed_base_vertex(uint32_t index_count, uint32_t base_index, uint32_t base_vertex)
-	{
-		if (!g_current_vb)
-		{
-			std::cout << "DRAW INDEXED ERROR: No vertex buffer bound!" << std::endl;
-			return;
-		}
+				float min_x = INFINITY;
+				float min_y = INFINITY;
+				float max_x = -INFINITY;
+				float max_y = -INFINITY;
 
-		if (!g_current_ib)
-		{
-			std::cout << "DRAW INDEXED ERROR: No index buffer bound!" << std::endl;
-			return;
-		}
+				for (int corner = 0; corner < 8; corner++)
+				{
+					vec4f p = projection * vec4f(center.x + ((corner & 1) ? radius : -radius),
+												 center.y + ((corner & 2) ? radius : -radius),
+												 center.z + ((corner & 4) ? radius : -radius),
+												 1.0f);
 
-		// Retrieve vertices and indices vectors from vertex and index buffers.
-		std::vector<uint32_t>& indices = g_current_ib->indices;
-		std::vector<Vertex>& vertices = g_current_vb->vertices;
+					// Only the frustum planes matter here, so the guard band is irrelevant
+					outcode &= compute_outcode(p, 1.0f, 1.0f);
 
-		// Compute MVP matrix.
-		mat4f vp = g_current_projection_mat * g_current_view_mat;
+					if (p.w <= 0.0f)
+					{
+						behind_eye = true;
+						continue;
+					}
 
-		// Iterate over vertices.
-		#pragma omp parallel for
-		for (int i = 0; i < index_count; i += 3)
-		{
-			// Rasterize triangle.
-			triangle(vertices[base_vertex + indices[base_index + i]], vertices[base_vertex + indices[base_index + i + 1]], vertices[base_vertex + indices[base_index + i + 2]], vp, g_current_color_target, g_current_depth_target);
-		}
+					min_x = std::min(min_x, p.x / p.w);
+					min_y = std::min(min_y, p.y / p.w);
+					max_x = std::max(max_x, p.x / p.w);
+					max_y = std::max(max_y, p.y / p.w);
+				}
+
+				// Entirely outside one of the frustum planes
+				if (outcode)
+					continue;
+
+				// The bounds of a box crossing the eye plane are unbounded, so such lights are kept for every tile
+				if (!behind_eye)
+				{
+					min_x = std::max(min_x, -1.0f);
+					min_y = std::max(min_y, -1.0f);
+					max_x = std::min(max_x, 1.0f);
+					max_y = std::min(max_y, 1.0f);
+
+					min_tile_x = std::max(int32_t(floorf((min_x + 1.0f) * width * 0.5f)) / kTileSize, 0);
+					min_tile_y = std::max(int32_t(floorf((min_y + 1.0f) * height * 0.5f)) / kTileSize, 0);
+					max_tile_x = std::min(int32_t(floorf((max_x + 1.0f) * width * 0.5f)) / kTileSize, tiles_x - 1);
+					max_tile_y = std::min(int32_t(floorf((max_y + 1.0f) * height * 0.5f)) / kTileSize, tiles_y - 1);
+				}
+			}
+
+			for (int32_t y = min_tile_y; y <= max_tile_y; y++)
+			{
+				for (int32_t x = min_tile_x; x <= max_tile_x; x++)
+					draw_state.tile_lights[y * tiles_x + x].push_back(i);
+			}
+		}
+	}
+
+	// -----------------------------------------------------------------------------------------------------------------------------------
+
+	// Starts a new, empty batch.
+	void clear_draws(ContextState& state)
+	{
+		state.draws.clear();
+		state.draw_state_count = 0;
+		state.draw_state_dirty = true;
+		state.batch_vertex_count = 0;
+		state.batch_triangle_count = 0;
+	}
+
+	// -----------------------------------------------------------------------------------------------------------------------------------
+
+	// Adds a draw to the current batch, capturing the bound state. 'vertices' already includes the base vertex.
+	void queue_draw(ContextState& state, const Vertex* vertices, const uint32_t* indices, uint32_t triangle_count)
+	{
+		if (triangle_count == 0)
+			return;
+
+		// Range of vertices referenced by the draw, so that each is transformed exactly once instead of once for every
+		// triangle that shares it
+		uint32_t first_vertex = 0;
+		uint32_t vertex_count = triangle_count * 3;
+
+		if (indices)
+		{
+			uint32_t min_index = indices[0];
+			uint32_t max_index = indices[0];
+
+			for (uint32_t i = 1; i < triangle_count * 3; i++)
+			{
+				min_index = std::min(min_index, indices[i]);
+				max_index = std::max(max_index, indices[i]);
+			}
+
+			first_vertex = min_index;
+			vertex_count = max_index - min_index + 1;
+		}
+
+		if (state.pipeline_dirty)
+			update_pipeline(state);
+
+		// Snapshot the shading state if it changed since the previous draw
+		if (state.draw_state_dirty || state.draw_state_count == 0)
+		{
+			if (state.draw_states.size() <= state.draw_state_count)
+				state.draw_states.resize(state.draw_state_count + 1);
+
+			DrawState& draw_state = state.draw_states[state.draw_state_count++];
+
+			draw_state.builtin = state.builtin;
+			draw_state.view_mat = state.view_mat;
+			draw_state.projection_mat = state.projection_mat;
+
+			state.draw_state_dirty = false;
+		}
+
+		DrawCall draw;
+
+		draw.vertices = vertices + first_vertex;
+		draw.indices = indices;
+		draw.first_vertex = first_vertex;
+		draw.vertex_count = vertex_count;
+		draw.triangle_count = triangle_count;
+		draw.vertex_offset = state.batch_vertex_count;
+		draw.triangle_offset = state.batch_triangle_count;
+		draw.model_mat = state.model_mat;
+		draw.vp_mat = state.projection_mat * state.view_mat;
+		draw.cull_mode = state.cull_mode;
+		draw.front_face = state.front_face;
+		draw.shaded = state.shader_bound;
+		draw.shader_program = state.shader_program;
+		draw.varying_count = draw.shaded ? state.shader_program.varying_count : uint32_t(VARYING_COUNT);
+		draw.rasterize = draw.shaded ? state.shader_program.rasterize[state.depth_write ? 1 : 0] : state.rasterize;
+		draw.draw_state = state.draw_state_count - 1;
+
+		// Built-in shading state is resolved when the batch is executed, once the draw states stop moving
+		draw.shader = draw.shaded ? state.shader_program.shader : nullptr;
+
+		state.draws.push_back(draw);
+		state.batch_vertex_count += vertex_count;
+		state.batch_triangle_count += triangle_count;
+	}
+
+	// -----------------------------------------------------------------------------------------------------------------------------------
+
+	void queue_draw(ContextState& state, uint32_t first_index, uint32_t count)
+	{
+		if (!state.vb)
+		{
+			std::cout << "DRAW ERROR: No vertex buffer bound!" << std::endl;
+			return;
+		}
+
+		if (!state.color_target || !state.depth_target)
+		{
+			std::cout << "DRAW ERROR: No render target bound!" << std::endl;
+			return;
+		}
+
+		// Retrieve vertices vector from vertex buffer.
+		std::vector<Vertex>& vertices = state.vb->vertices;
+
+		queue_draw(state, &vertices[first_index], nullptr, count / 3);
+	}
+
+	// -----------------------------------------------------------------------------------------------------------------------------------
+
+	void queue_draw_indexed(ContextState& state, uint32_t index_count, uint32_t base_index, uint32_t base_vertex)
+	{
+		if (!state.vb)
+		{
+			std::cout << "DRAW INDEXED ERROR: No vertex buffer bound!" << std::endl;
+			return;
+		}
+
+		if (!state.ib)
+		{
+			std::cout << "DRAW INDEXED ERROR: No index buffer bound!" << std::endl;
+			return;
+		}
+
+		if (!state.color_target || !state.depth_target)
+		{
+			std::cout << "DRAW INDEXED ERROR: No render target bound!" << std::endl;
+			return;
+		}
+
+		// Retrieve vertices and indices vectors from vertex and index buffers.
+		std::vector<uint32_t>& indices = state.ib->indices;
+		std::vector<Vertex>& vertices = state.vb->vertices;
+
+		queue_draw(state, &vertices[base_vertex], &indices[base_index], index_count / 3);
+	}
+
+	// -----------------------------------------------------------------------------------------------------------------------------------
+
+	// Transforms the vertices [first, first + count) of a draw into the batch's post-transform buffers.
+	inline void run_vertex_job(ClipVertexBuffer& clip_vertices, std::vector<ClipVertex>& shader_vertices, const DrawCall& draw, uint32_t first, uint32_t count, float guard_band_x, float guard_band_y)
+	{
+		const Vertex* source = draw.vertices + first;
+		uint32_t offset = draw.vertex_offset + first;
+
+		if (draw.shaded)
+		{
+			// User vertex shader
+			draw.shader_program.vertex(draw.shader_program.shader, source, count, &shader_vertices[offset]);
+
+			for (uint32_t i = 0; i < count; i++)
+				clip_vertices.outcodes[offset + i] = compute_outcode(shader_vertices[offset + i].position, guard_band_x, guard_band_y);
+		}
+		else
+		{
+			// Eight vertices at a time, then a scalar tail for the remainder
+			simd::mat4fx8 model_x8 = simd::mat4fx8::broadcast(draw.model_mat);
+			simd::mat4fx8 vp_x8 = simd::mat4fx8::broadcast(draw.vp_mat);
+
+			uint32_t batch_end = (count / 8) * 8;
+
+			for (uint32_t i = 0; i < batch_end; i += 8)
+				transform_vertices(clip_vertices, source + i, offset + i, model_x8, vp_x8, guard_band_x, guard_band_y);
+
+			for (uint32_t i = batch_end; i < count; i++)
+			{
+				ClipVertex v;
+
+				transform_vertex(source[i], draw.model_mat, draw.vp_mat, v);
+				store_clip_vertex(clip_vertices, offset + i, v);
+
+				clip_vertices.outcodes[offset + i] = compute_outcode(v.position, guard_band_x, guard_band_y);
+			}
+		}
+	}
+
+	// -----------------------------------------------------------------------------------------------------------------------------------
+
+	// Counts the pixels a draw covered in a tile, and adds them to the pixels the batch covered.
+	inline uint64_t merge_coverage(uint64_t* draw_coverage, uint64_t* batch_coverage)
+	{
+		uint64_t covered = 0;
+
+		for (int32_t y = 0; y < kTileSize; y++)
+		{
+			covered += _mm_popcnt_u64(draw_coverage[y]);
+			batch_coverage[y] |= draw_coverage[y];
+			draw_coverage[y] = 0;
+		}
+
+		return covered;
+	}
+
+	// -----------------------------------------------------------------------------------------------------------------------------------
+
+	inline void add_statistics(PipelineStatistics& total, const PipelineStatistics& statistics)
+	{
+		total.triangles_submitted += statistics.triangles_submitted;
+		total.triangles_frustum_culled += statistics.triangles_frustum_culled;
+		total.triangles_clipped += statistics.triangles_clipped;
+		total.triangles_backface_culled += statistics.triangles_backface_culled;
+		total.triangles_zero_area_culled += statistics.triangles_zero_area_culled;
+		total.tiles_hiz_culled += statistics.tiles_hiz_culled;
+		total.blocks_hiz_culled += statistics.blocks_hiz_culled;
+		total.pixels_tested += statistics.pixels_tested;
+		total.pixels_depth_passed += statistics.pixels_depth_passed;
+		total.pixels_depth_failed += statistics.pixels_depth_failed;
+		total.pixels_covered += statistics.pixels_covered;
+		total.texture_samples += statistics.texture_samples;
+		total.light_evaluations += statistics.light_evaluations;
+	}
+
+	// -----------------------------------------------------------------------------------------------------------------------------------
+
+	// Sums the counters of every thread into the statistics of each draw of the batch and into the totals.
+	void merge_statistics(ContextState& state, uint32_t draw_count, int32_t threads)
+	{
+		uint64_t pixels_covered = state.statistics.pixels_covered;
+
+		for (uint32_t d = 0; d < draw_count; d++)
+		{
+			PipelineStatistics draw;
+
+			for (int32_t t = 0; t < threads; t++)
+				add_statistics(draw, state.thread_statistics[t * draw_count + d]);
+
+			draw.pixels_depth_failed = draw.pixels_tested - draw.pixels_depth_passed;
+
+			state.draw_statistics.push_back(draw);
+			add_statistics(state.statistics, draw);
+		}
+
+		// Pixels covered by several draws only count once towards the batch
+		for (int32_t t = 0; t < threads; t++)
+			pixels_covered += state.thread_pixels_covered[t];
+
+		state.statistics.pixels_covered = pixels_covered;
+	}
+
+	// -----------------------------------------------------------------------------------------------------------------------------------
+
+	inline uint64_t elapsed_ns(std::chrono::steady_clock::time_point& start)
+	{
+		std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+		uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(now - start).count();
+
+		start = now;
+		return ns;
+	}
+
+	// -----------------------------------------------------------------------------------------------------------------------------------
+
+	// Runs the queued draws through the pipeline. The vertex stage and the front-end of all draws share one parallel loop
+	// each, and the back-end rasterizes the triangles of the whole batch in one pass over the tiles, in submission order.
+	void execute_draws(ContextState& state)
+	{
+		std::vector<DrawCall>& draws = state.draws;
+
+		if (draws.empty())
+			return;
+
+		RST_PROFILE_SCOPE("Execute Batch");
+
+		std::chrono::steady_clock::time_point stage_start = std::chrono::steady_clock::now();
+
+		Texture* color_tex = state.color_target;
+		Texture* depth_tex = state.depth_target;
+
+		uint32_t width = color_tex->m_width;
+		uint32_t height = color_tex->m_height;
+
+		// Guard band extent in NDC units
+		float guard_band_x = 2.0f * kGuardBand / width - 1.0f;
+		float guard_band_y = 2.0f * kGuardBand / height - 1.0f;
+
+		int32_t tiles_x = (width + kTileSize - 1) / kTileSize;
+		int32_t tiles_y = (height + kTileSize - 1) / kTileSize;
+		int32_t tile_count = tiles_x * tiles_y;
+		int32_t threads = thread_count(state);
+		int32_t bins = threads;
+
+		// Reuse the bin storage from the previous batch, only growing it when needed.
+		if (state.bins.size() < size_t(bins))
+			state.bins.resize(bins);
+
+		for (int32_t i = 0; i < bins; i++)
+		{
+			state.bins[i].triangles.clear();
+			state.bins[i].draws.clear();
+			state.bins[i].tiles.resize(tile_count);
+
+			for (auto& tile : state.bins[i].tiles)
+				tile.clear();
+		}
+
+		ClipVertexBuffer& clip_vertices = state.clip_vertices;
+		std::vector<ClipVertex>& shader_vertices = state.shader_vertices;
+		std::vector<VertexJob>& jobs = state.vertex_jobs;
+
+		resize_clip_vertex_buffer(clip_vertices, state.batch_vertex_count);
+
+		// Split the vertex stage of every draw into jobs of similar size, so small and large draws balance across threads
+		bool shaded = false;
+
+		jobs.clear();
+
+		for (uint32_t i = 0; i < draws.size(); i++)
+		{
+			shaded = shaded || draws[i].shaded;
+
+			for (uint32_t first = 0; first < draws[i].vertex_count; first += kVertexJobSize)
+			{
+				VertexJob job;
+
+				job.draw = i;
+				job.first = first;
+				job.count = std::min(kVertexJobSize, draws[i].vertex_count - first);
+
+				jobs.push_back(job);
+			}
+		}
+
+		if (shaded && shader_vertices.size() < state.batch_vertex_count)
+			shader_vertices.resize(state.batch_vertex_count);
+
+		// Vertex stage
+		#pragma omp parallel for schedule(dynamic, 1) num_threads(threads)
+		for (int32_t i = 0; i < int32_t(jobs.size()); i++)
+		{
+			RST_PROFILE_SCOPE("Vertex Job");
+			run_vertex_job(clip_vertices, shader_vertices, draws[jobs[i].draw], jobs[i].first, jobs[i].count, guard_band_x, guard_band_y);
+		}
+
+		state.timings.vertex += elapsed_ns(stage_start);
+
+		// Front-end: each bin receives a contiguous range of the batch's triangles which are set up and sorted into the
+		// screen tiles they overlap. Walking the bins in order afterwards visits every tile's triangles in submission order.
+		uint32_t triangle_count = state.batch_triangle_count;
+		uint32_t draw_count = uint32_t(draws.size());
+		bool statistics = state.statistics_enabled;
+
+		if (statistics)
+		{
+			state.thread_statistics.assign(threads * draw_count, PipelineStatistics());
+			state.thread_pixels_covered.assign(threads, 0);
+		}
+
+		#pragma omp parallel for schedule(static, 1) num_threads(threads)
+		for (int32_t i = 0; i < bins; i++)
+		{
+			RST_PROFILE_SCOPE("Bin Triangles");
+
+			Bin& bin = state.bins[i];
+
+			// Bins map one to one onto threads
+			PipelineStatistics* bin_statistics = statistics ? &state.thread_statistics[i * draw_count] : nullptr;
+
+			uint32_t first = (uint64_t(triangle_count) * i) / bins;
+			uint32_t last = (uint64_t(triangle_count) * (i + 1)) / bins;
+
+			uint32_t d = 0;
+
+			for (uint32_t t = first; t < last; t++)
+			{
+				// Advance to the draw the triangle belongs to
+				while (t >= draws[d].triangle_offset + draws[d].triangle_count)
+					d++;
+
+				const DrawCall& draw = draws[d];
+
+				if (bin_statistics)
+					bin_statistics[d].triangles_submitted++;
+
+				// Primitive assembly from the post-transform buffer
+				uint32_t local = t - draw.triangle_offset;
+				uint32_t i0 = local * 3;
+				uint32_t i1 = local * 3 + 1;
+				uint32_t i2 = local * 3 + 2;
+
+				if (draw.indices)
+				{
+					i0 = draw.indices[i0] - draw.first_vertex;
+					i1 = draw.indices[i1] - draw.first_vertex;
+					i2 = draw.indices[i2] - draw.first_vertex;
+				}
+
+				i0 += draw.vertex_offset;
+				i1 += draw.vertex_offset;
+				i2 += draw.vertex_offset;
+
+				uint32_t outcode0 = clip_vertices.outcodes[i0];
+				uint32_t outcode1 = clip_vertices.outcodes[i1];
+				uint32_t outcode2 = clip_vertices.outcodes[i2];
+
+				// Trivially reject triangles entirely outside one of the frustum planes
+				if (outcode0 & outcode1 & outcode2)
+				{
+					if (bin_statistics)
+						bin_statistics[d].triangles_frustum_culled++;
+
+					continue;
+				}
+
+				ClipVertex polygon[kMaxClipVertices];
+
+				if (draw.shaded)
+				{
+					polygon[0] = shader_vertices[i0];
+					polygon[1] = shader_vertices[i1];
+					polygon[2] = shader_vertices[i2];
+				}
+				else
+				{
+					load_clip_vertex(clip_vertices, i0, polygon[0]);
+					load_clip_vertex(clip_vertices, i1, polygon[1]);
+					load_clip_vertex(clip_vertices, i2, polygon[2]);
+				}
+
+				uint32_t count = 3;
+				uint32_t clip = (outcode0 | outcode1 | outcode2) & CLIP_REQUIRED;
+				uint32_t varying_count = draw.varying_count;
+
+				if (bin_statistics && clip)
+					bin_statistics[d].triangles_clipped++;
+
+				// Clip against the near plane, and against the guard band for vertices too far off-screen to rasterize. All
+				// other planes are handled by clamping the bounding box to the render target.
+				if (clip & CLIP_NEAR)
+					clip_polygon(polygon, count, vec4f(0.0f, 0.0f, 1.0f, 1.0f), varying_count);
+
+				if (clip & CLIP_GUARD_BAND_LEFT)
+					clip_polygon(polygon, count, vec4f(1.0f, 0.0f, 0.0f, guard_band_x), varying_count);
+
+				if (clip & CLIP_GUARD_BAND_RIGHT)
+					clip_polygon(polygon, count, vec4f(-1.0f, 0.0f, 0.0f, guard_band_x), varying_count);
+
+				if (clip & CLIP_GUARD_BAND_BOTTOM)
+					clip_polygon(polygon, count, vec4f(0.0f, 1.0f, 0.0f, guard_band_y), varying_count);
+
+				if (clip & CLIP_GUARD_BAND_TOP)
+					clip_polygon(polygon, count, vec4f(0.0f, -1.0f, 0.0f, guard_band_y), varying_count);
+
+				// Set up and bin the clipped polygon as a triangle fan
+				for (uint32_t j = 2; j < count; j++)
+				{
+					TriangleSetup tri;
+
+					SetupResult result = setup_triangle(polygon[0], polygon[j - 1], polygon[j], varying_count, width, height, draw.cull_mode, draw.front_face, tri);
+
+					if (result == SETUP_ACCEPTED)
+						bin_triangle(bin, tri, d, tiles_x);
+					else if (bin_statistics)
+					{
+						if (result == SETUP_OFF_SCREEN)
+							bin_statistics[d].triangles_frustum_culled++;
+						else if (result == SETUP_ZERO_AREA)
+							bin_statistics[d].triangles_zero_area_culled++;
+						else
+							bin_statistics[d].triangles_backface_culled++;
+					}
+				}
+			}
+		}
+
+		{
+			RST_PROFILE_SCOPE("Cull Lights");
+
+			for (uint32_t i = 0; i < state.draw_state_count; i++)
+				cull_point_lights(state.draw_states[i], width, height, tiles_x, tiles_y);
+		}
+
+		for (auto& draw : draws)
+		{
+			if (!draw.shaded)
+				draw.shader = &state.draw_states[draw.draw_state].builtin;
+		}
+
+		state.timings.setup += elapsed_ns(stage_start);
+
+		// Back-end: each thread owns a whole tile at a time, so depth and color writes never overlap between threads.
+		#pragma omp parallel for schedule(dynamic, 1) num_threads(threads)
+		for (int32_t i = 0; i < tile_count; i++)
+		{
+			RST_PROFILE_SCOPE("Raster Tile");
+
+			Tile tile;
+
+			tile.index = i;
+			tile.min_x = (i % tiles_x) * kTileSize;
+			tile.min_y = (i / tiles_x) * kTileSize;
+			tile.max_x = std::min(tile.min_x + kTileSize, int32_t(width)) - 1;
+			tile.max_y = std::min(tile.min_y + kTileSize, int32_t(height)) - 1;
+			tile.statistics = nullptr;
+			tile.coverage = nullptr;
+
+			// Pixels written in the tile by the current draw and by the whole batch
+			uint64_t draw_coverage[kTileSize];
+			uint64_t batch_coverage[kTileSize];
+
+			PipelineStatistics* thread_statistics = nullptr;
+			uint32_t current_draw = draw_count;
+
+			if (statistics)
+			{
+				thread_statistics = &state.thread_statistics[thread_index() * draw_count];
+
+				memset(draw_coverage, 0, sizeof(draw_coverage));
+				memset(batch_coverage, 0, sizeof(batch_coverage));
+			}
+
+			for (int32_t j = 0; j < bins; j++)
+			{
+				const Bin& bin = state.bins[j];
+
+				for (uint32_t index : bin.tiles[i])
+				{
+					uint32_t d = bin.draws[index];
+					const DrawCall& draw = draws[d];
+
+					// Triangles arrive in submission order, so each draw's pixels are complete once the next draw starts
+					if (thread_statistics && d != current_draw)
+					{
+						if (current_draw < draw_count)
+							thread_statistics[current_draw].pixels_covered += merge_coverage(draw_coverage, batch_coverage);
+
+						current_draw = d;
+						tile.statistics = &thread_statistics[d];
+						tile.coverage = draw_coverage;
+					}
+
+					tile.point_lights = &state.draw_states[draw.draw_state].tile_lights[i];
+					draw.rasterize(bin.triangles[index], tile, color_tex, depth_tex, draw.shader);
+				}
+			}
+
+			if (thread_statistics)
+			{
+				if (current_draw < draw_count)
+					thread_statistics[current_draw].pixels_covered += merge_coverage(draw_coverage, batch_coverage);
+
+				for (int32_t y = 0; y < kTileSize; y++)
+					state.thread_pixels_covered[thread_index()] += _mm_popcnt_u64(batch_coverage[y]);
+			}
+		}
+
+		if (statistics)
+			merge_statistics(state, draw_count, threads);
+
+		state.timings.raster += elapsed_ns(stage_start);
+		state.timings.batches++;
+
+		clear_draws(state);
+	}
+
+	// -----------------------------------------------------------------------------------------------------------------------------------
+
+	Context::Context() : m_state(new ContextState())
+	{
+		reset();
+	}
+
+	// -----------------------------------------------------------------------------------------------------------------------------------
+
+	Context::~Context()
+	{
+		RST_SAFE_DELETE(m_state);
+	}
+
+	// -----------------------------------------------------------------------------------------------------------------------------------
+
+	void Context::reset()
+	{
+		ContextState& state = *m_state;
+
+		state.vb = nullptr;
+		state.ib = nullptr;
+		state.color_target = nullptr;
+		state.depth_target = nullptr;
+		state.model_mat = mat4f();
+		state.view_mat = mat4f();
+		state.projection_mat = mat4f();
+		state.cull_mode = CULL_MODE_BACK;
+		state.front_face = FRONT_FACE_CCW;
+		state.filter_mode = FILTER_MODE_BILINEAR;
+		state.depth_write = true;
+		state.thread_count = 0;
+		state.statistics_enabled = false;
+		state.rasterize = nullptr;
+		state.pipeline_dirty = true;
+		state.shader_bound = false;
+
+		for (int i = 0; i < 3; i++)
+			state.builtin.textures[i] = nullptr;
+
+		clear_draws(state);
+
+		set_directional_lights(0, nullptr);
+		set_point_lights(0, nullptr);
+	}
+
+	// -----------------------------------------------------------------------------------------------------------------------------------
+
+	void Context::set_thread_count(uint32_t count)
+	{
+		m_state->thread_count = count;
+	}
+
+	// -----------------------------------------------------------------------------------------------------------------------------------
+
+	void Context::set_vertex_buffer(VertexBuffer* vb)
+	{
+		m_state->vb = vb;
+	}
+
+	// -----------------------------------------------------------------------------------------------------------------------------------
+
+	void Context::set_index_buffer(IndexBuffer* ib)
+	{
+		m_state->ib = ib;
+	}
+
+	// -----------------------------------------------------------------------------------------------------------------------------------
+
+	void Context::set_directional_lights(uint32_t count, const DirectionalLight* lights)
+	{
+		BuiltinShader& builtin = m_state->builtin;
+
+		builtin.dir_light_count = lights ? count : 0;
+		m_state->pipeline_dirty = true;
+		m_state->draw_state_dirty = true;
+
+		for (int i = 0; i < 3; i++)
+			builtin.dir_lights.direction[i].resize(builtin.dir_light_count);
+
+		for (uint32_t i = 0; i < builtin.dir_light_count; i++)
+		{
+			builtin.dir_lights.direction[0][i] = -lights[i].direction.x;
+			builtin.dir_lights.direction[1][i] = -lights[i].direction.y;
+			builtin.dir_lights.direction[2][i] = -lights[i].direction.z;
+		}
+	}
+
+	// -----------------------------------------------------------------------------------------------------------------------------------
+
+	void Context::set_point_lights(uint32_t count, const PointLight* lights)
+	{
+		BuiltinShader& builtin = m_state->builtin;
+		PointLightBuffer& point_lights = builtin.point_lights;
+
+		builtin.point_light_count = lights ? count : 0;
+		m_state->pipeline_dirty = true;
+		m_state->draw_state_dirty = true;
+
+		for (int i = 0; i < 3; i++)
+			point_lights.position[i].resize(builtin.point_light_count);
+
+		point_lights.constant.resize(builtin.point_light_count);
+		point_lights.linear.resize(builtin.point_light_count);
+		point_lights.quadratic.resize(builtin.point_light_count);
+		point_lights.radius.resize(builtin.point_light_count);
+
+		for (uint32_t i = 0; i < builtin.point_light_count; i++)
+		{
+			point_lights.position[0][i] = lights[i].position.x;
+			point_lights.position[1][i] = lights[i].position.y;
+			point_lights.position[2][i] = lights[i].position.z;
+			point_lights.constant[i] = lights[i].constant;
+			point_lights.linear[i] = lights[i].linear;
+			point_lights.quadratic[i] = lights[i].quadratic;
+			point_lights.radius[i] = light_radius(lights[i]);
+		}
+	}
+
+	// -----------------------------------------------------------------------------------------------------------------------------------
+
+	void Context::set_render_target(Texture* color, Texture* depth)
+	{
+		if ((color && color->m_layout == TEXTURE_LAYOUT_SWIZZLED) || (depth && depth->m_layout == TEXTURE_LAYOUT_SWIZZLED))
+		{
+			std::cout << "ERROR: Swizzled textures can't be bound as render targets!" << std::endl;
+			color = nullptr;
+			depth = nullptr;
+		}
+
+		// Draws of a batch share a render target
+		if (color != m_state->color_target || depth != m_state->depth_target)
+			execute_draws(*m_state);
+
+		m_state->color_target = color;
+		m_state->depth_target = depth;
+	}
+
+	// -----------------------------------------------------------------------------------------------------------------------------------
+
+	void Context::set_model_matrix(const mat4f& model)
+	{
+		m_state->model_mat = model;
+	}
+
+	// -----------------------------------------------------------------------------------------------------------------------------------
+
+	void Context::set_view_matrix(const mat4f& view)
+	{
+		m_state->view_mat = view;
+		m_state->draw_state_dirty = true;
+	}
+
+	// -----------------------------------------------------------------------------------------------------------------------------------
+
+	void Context::set_projection_matrix(const mat4f& projection)
+	{
+		m_state->projection_mat = projection;
+		m_state->draw_state_dirty = true;
+	}
+
+	// -----------------------------------------------------------------------------------------------------------------------------------
+
+	void Context::set_cull_mode(CullMode mode)
+	{
+		m_state->cull_mode = mode;
+	}
+
+	// -----------------------------------------------------------------------------------------------------------------------------------
+
+	void Context::set_front_face(FrontFace face)
+	{
+		m_state->front_face = face;
+	}
+
+	// -----------------------------------------------------------------------------------------------------------------------------------
+
+	void Context::set_filter_mode(FilterMode mode)
+	{
+		m_state->filter_mode = mode;
+		m_state->pipeline_dirty = true;
+	}
+
+	// -----------------------------------------------------------------------------------------------------------------------------------
+
+	void Context::set_depth_write(bool enable)
+	{
+		m_state->depth_write = enable;
+		m_state->pipeline_dirty = true;
+	}
+
+	// -----------------------------------------------------------------------------------------------------------------------------------
+
+	void Context::set_shader_program(const ShaderProgram& program)
+	{
+		m_state->shader_program = program;
+		m_state->shader_bound = true;
+	}
+
+	// -----------------------------------------------------------------------------------------------------------------------------------
+
+	void Context::reset_shader()
+	{
+		m_state->shader_bound = false;
+	}
+
+	// -----------------------------------------------------------------------------------------------------------------------------------
+
+	void Context::set_texture(const uint32_t& type, Texture* texture)
+	{
+		if (type > TEXTURE_SPECULAR)
+		{
+			std::cout << "ERROR: Invalid texture type!" << std::endl;
+			return;
+		}
+
+		m_state->builtin.textures[type] = texture;
+		m_state->pipeline_dirty = true;
+		m_state->draw_state_dirty = true;
+	}
+
+	// -----------------------------------------------------------------------------------------------------------------------------------
+
+	void Context::draw(uint32_t first_index, uint32_t count)
+	{
+		RST_PROFILE_SCOPE("Draw");
+
+		queue_draw(*m_state, first_index, count);
+		execute_draws(*m_state);
+	}
+
+	// -----------------------------------------------------------------------------------------------------------------------------------
+
+	void Context::draw_indexed(uint32_t count)
+	{
+		RST_PROFILE_SCOPE("Draw");
+
+		queue_draw_indexed(*m_state, count, 0, 0);
+		execute_draws(*m_state);
+	}
+
+	// -----------------------------------------------------------------------------------------------------------------------------------
+
+	void Context::draw_indexed_base_vertex(uint32_t index_count, uint32_t base_index, uint32_t base_vertex)
+	{
+		RST_PROFILE_SCOPE("Draw");
+
+		queue_draw_indexed(*m_state, index_count, base_index, base_vertex);
+		execute_draws(*m_state);
+	}
+
+	// -----------------------------------------------------------------------------------------------------------------------------------
+
+	void Context::submit(const CommandList& list)
+	{
+		submit(1, &list);
+	}
+
+	// -----------------------------------------------------------------------------------------------------------------------------------
+
+	void Context::submit(uint32_t count, const CommandList* lists)
+	{
+		RST_PROFILE_SCOPE("Submit");
+
+		for (uint32_t i = 0; i < count; i++)
+		{
+			const CommandListData& data = *lists[i].m_data;
+
+			for (const Command& command : data.commands)
+			{
+				switch (command.type)
+				{
+				case COMMAND_SET_VERTEX_BUFFER:
+					set_vertex_buffer(command.vb);
+					break;
+				case COMMAND_SET_INDEX_BUFFER:
+					set_index_buffer(command.ib);
+					break;
+				case COMMAND_SET_DIRECTIONAL_LIGHTS:
+					set_directional_lights(command.lights.count, command.lights.count > 0 ? &data.dir_lights[command.lights.first] : nullptr);
+					break;
+				case COMMAND_SET_POINT_LIGHTS:
+					set_point_lights(command.lights.count, command.lights.count > 0 ? &data.point_lights[command.lights.first] : nullptr);
+					break;
+				case COMMAND_SET_RENDER_TARGET:
+					set_render_target(command.target.color, command.target.depth);
+					break;
+				case COMMAND_SET_MODEL_MATRIX:
+					set_model_matrix(data.matrices[command.index]);
+					break;
+				case COMMAND_SET_VIEW_MATRIX:
+					set_view_matrix(data.matrices[command.index]);
+					break;
+				case COMMAND_SET_PROJECTION_MATRIX:
+					set_projection_matrix(data.matrices[command.index]);
+					break;
+				case COMMAND_SET_CULL_MODE:
+					set_cull_mode(command.cull_mode);
+					break;
+				case COMMAND_SET_FRONT_FACE:
+					set_front_face(command.front_face);
+					break;
+				case COMMAND_SET_FILTER_MODE:
+					set_filter_mode(command.filter_mode);
+					break;
+				case COMMAND_SET_DEPTH_WRITE:
+					set_depth_write(command.enable);
+					break;
+				case COMMAND_SET_TEXTURE:
+					set_texture(command.texture.type, command.texture.texture);
+					break;
+				case COMMAND_SET_SHADER_PROGRAM:
+					set_shader_program(data.shader_programs[command.index]);
+					break;
+				case COMMAND_RESET_SHADER:
+					reset_shader();
+					break;
+				case COMMAND_DRAW:
+					queue_draw(*m_state, command.draw.base_index, command.draw.count);
+					break;
+				case COMMAND_DRAW_INDEXED_BASE_VERTEX:
+					queue_draw_indexed(*m_state, command.draw.count, command.draw.base_index, command.draw.base_vertex);
+					break;
+				}
+			}
+		}
+
+		execute_draws(*m_state);
+	}
+
+	// -----------------------------------------------------------------------------------------------------------------------------------
+
+	const StageTimings& Context::stage_timings() const
+	{
+		return m_state->timings;
+	}
+
+	// -----------------------------------------------------------------------------------------------------------------------------------
+
+	void Context::reset_stage_timings()
+	{
+		m_state->timings = StageTimings();
+	}
+
+	// -----------------------------------------------------------------------------------------------------------------------------------
+
+	void Context::set_statistics_enabled(bool enable)
+	{
+		m_state->statistics_enabled = enable;
+	}
+
+	// -----------------------------------------------------------------------------------------------------------------------------------
+
+	const PipelineStatistics& Context::statistics() const
+	{
+		return m_state->statistics;
+	}
+
+	// -----------------------------------------------------------------------------------------------------------------------------------
+
+	const std::vector<PipelineStatistics>& Context::draw_statistics() const
+	{
+		return m_state->draw_statistics;
+	}
+
+	// -----------------------------------------------------------------------------------------------------------------------------------
+
+	void Context::reset_statistics()
+	{
+		m_state->statistics = PipelineStatistics();
+		m_state->draw_statistics.clear();
+	}
+
+	// -----------------------------------------------------------------------------------------------------------------------------------
+
+	CommandList::CommandList() : m_data(new CommandListData())
+	{
+
+	}
+
+	// -----------------------------------------------------------------------------------------------------------------------------------
+
+	CommandList::~CommandList()
+	{
+		RST_SAFE_DELETE(m_data);
+	}
+
+	// -----------------------------------------------------------------------------------------------------------------------------------
+
+	void CommandList::reset()
+	{
+		m_data->commands.clear();
+		m_data->matrices.clear();
+		m_data->dir_lights.clear();
+		m_data->point_lights.clear();
+		m_data->shader_programs.clear();
+	}
+
+	// -----------------------------------------------------------------------------------------------------------------------------------
+
+	void CommandList::set_vertex_buffer(VertexBuffer* vb)
+	{
+		Command command;
+
+		command.type = COMMAND_SET_VERTEX_BUFFER;
+		command.vb = vb;
+
+		m_data->commands.push_back(command);
+	}
+
+	// -----------------------------------------------------------------------------------------------------------------------------------
+
+	void CommandList::set_index_buffer(IndexBuffer* ib)
+	{
+		Command command;
+
+		command.type = COMMAND_SET_INDEX_BUFFER;
+		command.ib = ib;
+
+		m_data->commands.push_back(command);
+	}
+
+	// -----------------------------------------------------------------------------------------------------------------------------------
+
+	void CommandList::set_directional_lights(uint32_t count, const DirectionalLight* lights)
+	{
+		Command command;
+
+		command.type = COMMAND_SET_DIRECTIONAL_LIGHTS;
+		command.lights.first = m_data->dir_lights.size();
+		command.lights.count = lights ? count : 0;
+
+		m_data->dir_lights.insert(m_data->dir_lights.end(), lights, lights + command.lights.count);
+		m_data->commands.push_back(command);
+	}
+
+	// -----------------------------------------------------------------------------------------------------------------------------------
+
+	void CommandList::set_point_lights(uint32_t count, const PointLight* lights)
+	{
+		Command command;
+
+		command.type = COMMAND_SET_POINT_LIGHTS;
+		command.lights.first = m_data->point_lights.size();
+		command.lights.count = lights ? count : 0;
+
+		m_data->point_lights.insert(m_data->point_lights.end(), lights, lights + command.lights.count);
+		m_data->commands.push_back(command);
+	}
+
+	// -----------------------------------------------------------------------------------------------------------------------------------
+
+	void CommandList::set_render_target(Texture* color, Texture* depth)
+	{
+		Command command;
+
+		command.type = COMMAND_SET_RENDER_TARGET;
+		command.target.color = color;
+		command.target.depth = depth;
+
+		m_data->commands.push_back(command);
+	}
+
+	// -----------------------------------------------------------------------------------------------------------------------------------
+
+	void CommandList::set_model_matrix(const mat4f& model)
+	{
+		Command command;
+
+		command.type = COMMAND_SET_MODEL_MATRIX;
+		command.index = m_data->matrices.size();
+
+		m_data->matrices.push_back(model);
+		m_data->commands.push_back(command);
+	}
+
+	// -----------------------------------------------------------------------------------------------------------------------------------
+
+	void CommandList::set_view_matrix(const mat4f& view)
+	{
+		Command command;
+
+		command.type = COMMAND_SET_VIEW_MATRIX;
+		command.index = m_data->matrices.size();
+
+		m_data->matrices.push_back(view);
+		m_data->commands.push_back(command);
+	}
+
+	// -----------------------------------------------------------------------------------------------------------------------------------
+
+	void CommandList::set_projection_matrix(const mat4f& projection)
+	{
+		Command command;
+
+		command.type = COMMAND_SET_PROJECTION_MATRIX;
+		command.index = m_data->matrices.size();
+
+		m_data->matrices.push_back(projection);
+		m_data->commands.push_back(command);
+	}
+
+	// -----------------------------------------------------------------------------------------------------------------------------------
+
+	void CommandList::set_cull_mode(CullMode mode)
+	{
+		Command command;
+
+		command.type = COMMAND_SET_CULL_MODE;
+		command.cull_mode = mode;
+
+		m_data->commands.push_back(command);
+	}
+
+	// -----------------------------------------------------------------------------------------------------------------------------------
+
+	void CommandList::set_front_face(FrontFace face)
+	{
+		Command command;
+
+		command.type = COMMAND_SET_FRONT_FACE;
+		command.front_face = face;
+
+		m_data->commands.push_back(command);
+	}
+
+	// -----------------------------------------------------------------------------------------------------------------------------------
+
+	void CommandList::set_filter_mode(FilterMode mode)
+	{
+		Command command;
+
+		command.type = COMMAND_SET_FILTER_MODE;
+		command.filter_mode = mode;
+
+		m_data->commands.push_back(command);
+	}
+
+	// -----------------------------------------------------------------------------------------------------------------------------------
+
+	void CommandList::set_depth_write(bool enable)
+	{
+		Command command;
+
+		command.type = COMMAND_SET_DEPTH_WRITE;
+		command.enable = enable;
+
+		m_data->commands.push_back(command);
+	}
+
+	// -----------------------------------------------------------------------------------------------------------------------------------
+
+	void CommandList::set_texture(const uint32_t& type, Texture* texture)
+	{
+		Command command;
+
+		command.type = COMMAND_SET_TEXTURE;
+		command.texture.type = type;
+		command.texture.texture = texture;
+
+		m_data->commands.push_back(command);
+	}
+
+	// -----------------------------------------------------------------------------------------------------------------------------------
+
+	void CommandList::set_shader_program(const ShaderProgram& program)
+	{
+		Command command;
+
+		command.type = COMMAND_SET_SHADER_PROGRAM;
+		command.index = m_data->shader_programs.size();
+
+		m_data->shader_programs.push_back(program);
+		m_data->commands.push_back(command);
+	}
+
+	// -----------------------------------------------------------------------------------------------------------------------------------
+
+	void CommandList::reset_shader()
+	{
+		Command command;
+
+		command.type = COMMAND_RESET_SHADER;
+
+		m_data->commands.push_back(command);
+	}
+
+	// -----------------------------------------------------------------------------------------------------------------------------------
+
+	void CommandList::draw(uint32_t first_index, uint32_t count)
+	{
+		Command command;
+
+		command.type = COMMAND_DRAW;
+		command.draw.count = count;
+		command.draw.base_index = first_index;
+		command.draw.base_vertex = 0;
+
+		m_data->commands.push_back(command);
+	}
+
+	// -----------------------------------------------------------------------------------------------------------------------------------
+
+	void CommandList::draw_indexed(uint32_t count)
+	{
+		draw_indexed_base_vertex(count, 0, 0);
+	}
+
+	// -----------------------------------------------------------------------------------------------------------------------------------
+
+	void CommandList::draw_indexed_base_vertex(uint32_t index_count, uint32_t base_index, uint32_t base_vertex)
+	{
+		Command command;
+
+		command.type = COMMAND_DRAW_INDEXED_BASE_VERTEX;
+		command.draw.count = index_count;
+		command.draw.base_index = base_index;
+		command.draw.base_vertex = base_vertex;
+
+		m_data->commands.push_back(command);
+	}
+
+	// -----------------------------------------------------------------------------------------------------------------------------------
+
+	void set_base_path(const std::string& path)
+	{
+		g_base_path = path;
+	}
+
+	// -----------------------------------------------------------------------------------------------------------------------------------
+
+	Context& default_context()
+	{
+		static Context context;
+		return context;
+	}
+
+	// -----------------------------------------------------------------------------------------------------------------------------------
+
+	// Free functions, forwarding to the default context.
+	void initialize()
+	{
+		default_context().reset();
+	}
+
+	// -----------------------------------------------------------------------------------------------------------------------------------
+
+	void set_vertex_buffer(VertexBuffer* vb)
+	{
+		default_context().set_vertex_buffer(vb);
+	}
+
+	// -----------------------------------------------------------------------------------------------------------------------------------
+
+	void set_index_buffer(IndexBuffer* ib)
+	{
+		default_context().set_index_buffer(ib);
+	}
+
+	// -----------------------------------------------------------------------------------------------------------------------------------
+
+	void set_directional_lights(uint32_t count, const DirectionalLight* lights)
+	{
+		default_context().set_directional_lights(count, lights);
+	}
+
+	// -----------------------------------------------------------------------------------------------------------------------------------
+
+	void set_point_lights(uint32_t count, const PointLight* lights)
+	{
+		default_context().set_point_lights(count, lights);
+	}
+
+	// -----------------------------------------------------------------------------------------------------------------------------------
+
+	void set_render_target(Texture* color, Texture* depth)
+	{
+		default_context().set_render_target(color, depth);
+	}
+
+	// -----------------------------------------------------------------------------------------------------------------------------------
+
+	void set_model_matrix(const mat4f& model)
+	{
+		default_context().set_model_matrix(model);
+	}
+
+	// -----------------------------------------------------------------------------------------------------------------------------------
+
+	void set_view_matrix(const mat4f& view)
+	{
+		default_context().set_view_matrix(view);
+	}
+
+	// -----------------------------------------------------------------------------------------------------------------------------------
+
+	void set_projection_matrix(const mat4f& projection)
+	{
+		default_context().set_projection_matrix(projection);
+	}
+
+	// -----------------------------------------------------------------------------------------------------------------------------------
+
+	void set_cull_mode(CullMode mode)
+	{
+		default_context().set_cull_mode(mode);
+	}
+
+	// -----------------------------------------------------------------------------------------------------------------------------------
+
+	void set_front_face(FrontFace face)
+	{
+		default_context().set_front_face(face);
+	}
+
+	// -----------------------------------------------------------------------------------------------------------------------------------
+
+	void set_filter_mode(FilterMode mode)
+	{
+		default_context().set_filter_mode(mode);
+	}
+
+	// -----------------------------------------------------------------------------------------------------------------------------------
+
+	void set_depth_write(bool enable)
+	{
+		default_context().set_depth_write(enable);
+	}
+
+	// -----------------------------------------------------------------------------------------------------------------------------------
+
+	void reset_shader()
+	{
+		default_context().reset_shader();
+	}
+
+	// -----------------------------------------------------------------------------------------------------------------------------------
+
+	void set_texture(const uint32_t& type, Texture* texture)
+	{
+		default_context().set_texture(type, texture);
+	}
+
+	// -----------------------------------------------------------------------------------------------------------------------------------
+
+	void draw(uint32_t first_index, uint32_t count)
+	{
+		default_context().draw(first_index, count);
+	}
+
+	// -----------------------------------------------------------------------------------------------------------------------------------
+
+	void draw_indexed(uint32_t count)
+	{
+		default_context().draw_indexed(count);
+	}
+
+	// -----------------------------------------------------------------------------------------------------------------------------------
+
+	void draw_indexed_base_vertex(uint32_t index_count, uint32_t base_index, uint32_t base_vertex)
+	{
+		default_context().draw_indexed_base_vertex(index_count, base_index, base_vertex);
+	}
+
+	// -----------------------------------------------------------------------------------------------------------------------------------
+
+	void submit(const CommandList& list)
+	{
+		default_context().submit(list);
+	}
+
+	// -----------------------------------------------------------------------------------------------------------------------------------
+
+	void submit(uint32_t count, const CommandList* lists)
+	{
+		default_context().submit(count, lists);
 	}
 
 	// -----------------------------------------------------------------------------------------------------------------------------------
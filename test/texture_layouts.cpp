@@ -0,0 +1,192 @@
+#include <rasterator.hpp>
+#include <math/transform.hpp>
+#include <math/utility.hpp>
+
+#include <iostream>
+#include <vector>
+
+// Renders the same scene with a linear and a swizzled copy of a mipmapped texture and checks that the images match in
+// every filter mode, and that swizzled textures are never rendered to.
+
+static const uint32_t kWidth = 300;
+static const uint32_t kHeight = 200;
+
+// Odd sized, so that the edge blocks of every mip level of the swizzled copy are partly filled
+static const uint32_t kTextureWidth = 181;
+static const uint32_t kTextureHeight = 97;
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static void add_quad(rst::VertexBuffer& vb, rst::IndexBuffer& ib, const vec3f* corners, const vec3f& normal)
+{
+	uint32_t base = uint32_t(vb.vertices.size());
+
+	for (uint32_t corner = 0; corner < 4; corner++)
+	{
+		rst::Vertex vertex;
+
+		vertex.position = corners[corner];
+		vertex.normal = normal;
+		vertex.tangent = vec3f(1.0f, 0.0f, 0.0f);
+		vertex.texcoord = vec2f((corner & 1) ? 1.0f : 0.0f, (corner & 2) ? 1.0f : 0.0f);
+
+		vb.vertices.push_back(vertex);
+	}
+
+	uint32_t indices[] = { base, base + 1, base + 3, base, base + 3, base + 2 };
+	ib.indices.insert(ib.indices.end(), indices, indices + 6);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// A floor receding into the distance, which samples every mip level, and overlapping quads in front of it that magnify
+// the texture.
+static void create_scene(rst::VertexBuffer& vb, rst::IndexBuffer& ib)
+{
+	vec3f floor[] = { vec3f(-60.0f, 0.0f, 140.0f), vec3f(60.0f, 0.0f, 140.0f), vec3f(-60.0f, 0.0f, -2000.0f), vec3f(60.0f, 0.0f, -2000.0f) };
+	add_quad(vb, ib, floor, vec3f(0.0f, 1.0f, 0.0f));
+
+	for (uint32_t i = 0; i < 8; i++)
+	{
+		float size = 12.0f - i;
+		float x = float(i % 4) * 12.0f - 18.0f;
+		float y = float(i / 4) * 10.0f + 30.0f;
+		float z = float(i) * 4.0f + 80.0f;
+
+		vec3f corners[] = { vec3f(x - size, y - size, z), vec3f(x + size, y - size, z), vec3f(x - size, y + size, z), vec3f(x + size, y + size, z) };
+		add_quad(vb, ib, corners, vec3f(0.0f, 0.0f, 1.0f));
+	}
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// Fills level 0 with a pattern that changes from texel to texel, so that a sample from the wrong texel shows up.
+static void fill_texture(rst::Texture& texture)
+{
+	for (uint32_t y = 0; y < texture.m_height; y++)
+	{
+		for (uint32_t x = 0; x < texture.m_width; x++)
+		{
+			uint32_t hash = (x * 73856093u) ^ (y * 19349663u);
+			texture.m_pixels[y * texture.m_width + x] = rst::Color(uint8_t(hash), uint8_t(hash >> 8), uint8_t(x * 255 / texture.m_width), 255);
+		}
+	}
+
+	texture.generate_mips();
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static std::vector<uint32_t> render(rst::FilterMode filter_mode, rst::Texture* diffuse, const rst::VertexBuffer& vb, const rst::IndexBuffer& ib)
+{
+	rst::Texture color_tex(kWidth, kHeight, false, rst::TEXTURE_LAYOUT_TILED);
+	rst::Texture depth_tex(kWidth, kHeight, true, rst::TEXTURE_LAYOUT_TILED);
+
+	depth_tex.clear();
+	color_tex.clear(0.0f, 0.0f, 0.0f, 1.0f);
+
+	rst::DirectionalLight dir_light;
+
+	dir_light.color = vec3f(1.0f, 1.0f, 1.0f);
+	dir_light.direction = vec3f(0.0f, -1.0f, -1.0f).normalize();
+
+	rst::Context context;
+
+	context.set_render_target(&color_tex, &depth_tex);
+	context.set_vertex_buffer(const_cast<rst::VertexBuffer*>(&vb));
+	context.set_index_buffer(const_cast<rst::IndexBuffer*>(&ib));
+	context.set_directional_lights(1, &dir_light);
+	context.set_texture(rst::TEXTURE_DIFFUSE, diffuse);
+	context.set_filter_mode(filter_mode);
+	context.set_projection_matrix(perspective(float(kWidth) / float(kHeight), radians(60.0f), 0.1f, 3000.0f));
+	context.set_view_matrix(lookat(vec3f(0.0f, 35.0f, 150.0f), vec3f(0.0f, 30.0f, 100.0f), vec3f(0.0f, 1.0f, 0.0f)));
+	context.set_model_matrix(mat4f());
+	context.draw_indexed_base_vertex(uint32_t(ib.indices.size()), 0, 0);
+
+	std::vector<uint32_t> pixels(kWidth * kHeight);
+	color_tex.resolve(pixels.data(), kWidth * sizeof(uint32_t));
+
+	return pixels;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+int main()
+{
+	rst::VertexBuffer vb;
+	rst::IndexBuffer ib;
+
+	create_scene(vb, ib);
+
+	rst::Texture linear(kTextureWidth, kTextureHeight);
+	rst::Texture swizzled(kTextureWidth, kTextureHeight);
+
+	fill_texture(linear);
+	fill_texture(swizzled);
+
+	swizzled.swizzle();
+
+	const rst::FilterMode filter_modes[] = { rst::FILTER_MODE_NEAREST, rst::FILTER_MODE_BILINEAR, rst::FILTER_MODE_MIP_NEAREST, rst::FILTER_MODE_TRILINEAR };
+	const char* filter_names[] = { "nearest", "bilinear", "mip nearest", "trilinear" };
+
+	bool passed = true;
+
+	for (uint32_t i = 0; i < 4; i++)
+	{
+		std::vector<uint32_t> expected = render(filter_modes[i], &linear, vb, ib);
+		std::vector<uint32_t> actual = render(filter_modes[i], &swizzled, vb, ib);
+
+		uint32_t covered = 0;
+		uint32_t mismatched = 0;
+
+		for (uint32_t j = 0; j < kWidth * kHeight; j++)
+		{
+			covered += expected[j] != expected[0] ? 1 : 0;
+			mismatched += actual[j] != expected[j] ? 1 : 0;
+		}
+
+		if (covered == 0)
+		{
+			std::cout << "FAILED: Nothing was rendered with " << filter_names[i] << " filtering" << std::endl;
+			passed = false;
+		}
+
+		if (mismatched != 0)
+		{
+			std::cout << "FAILED: " << mismatched << " pixels of the swizzled texture differ from linear with " << filter_names[i] << " filtering" << std::endl;
+			passed = false;
+		}
+	}
+
+	// Binding a swizzled texture as a render target is rejected, and draws leave it untouched
+	rst::Texture depth_tex(kTextureWidth, kTextureHeight, true);
+	depth_tex.clear();
+
+	std::vector<uint32_t> before(kTextureWidth * kTextureHeight);
+	std::vector<uint32_t> after(kTextureWidth * kTextureHeight);
+
+	swizzled.resolve(before.data(), kTextureWidth * sizeof(uint32_t));
+
+	rst::Context context;
+
+	context.set_render_target(&swizzled, &depth_tex);
+	context.set_vertex_buffer(&vb);
+	context.set_index_buffer(&ib);
+	context.set_projection_matrix(perspective(float(kTextureWidth) / float(kTextureHeight), radians(60.0f), 0.1f, 3000.0f));
+	context.set_view_matrix(lookat(vec3f(0.0f, 35.0f, 150.0f), vec3f(0.0f, 30.0f, 100.0f), vec3f(0.0f, 1.0f, 0.0f)));
+	context.set_model_matrix(mat4f());
+	context.draw_indexed_base_vertex(uint32_t(ib.indices.size()), 0, 0);
+
+	swizzled.resolve(after.data(), kTextureWidth * sizeof(uint32_t));
+
+	if (before != after)
+	{
+		std::cout << "FAILED: A swizzled texture was rendered to" << std::endl;
+		passed = false;
+	}
+
+	if (passed)
+		std::cout << "PASSED" << std::endl;
+
+	return passed ? 0 : 1;
+}